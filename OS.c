@@ -0,0 +1 @@
+os/Linux.c
\ No newline at end of file
@@ -12,7 +12,7 @@ extern "C" {
 }
 #endif
 
-#ifdef	PROCESSTABLE_THREAD
+#if defined(PROCESSTABLE_THREAD) || defined(PROCESSTABLE_SAMPLER)
 #include <pthread.h>
 #endif
 
@@ -33,19 +33,39 @@ extern "C" {
 /* prototypes to make the compiler shut up */
 void ppt_warn(const char*, ...);
 void ppt_die(const char*, ...);
-void store_ttydev(HV*, unsigned long);
+void store_ttydev(HV*, HV*, unsigned long);
 void bless_into_proc(char* , char**, ...);
 void OS_get_table();
 char* OS_initialize();
 
+/* The fields of the OS code, the same for every interpreter */
 char** Fields = NULL; 
 int Numfields;
+char* Format = NULL;                  /* type letters of the fields */
+const char* const* Units = NULL;      /* NULL if the OS code has none */
+
+/* Everything else is per interpreter, so objects in separate ithreads */
+/* or embedded interpreters don't share any state. Each scan has its   */
+/* own ppt_ctx (see below); ctx is the scan in progress, for           */
+/* bless_into_proc.                                                    */
+#define MY_CXT_KEY "Proc::ProcessTable::_guts" XS_VERSION
 
-/* Cache a pointer the TTY device number hash for quick lookups */
-HV* Ttydevs;
+typedef struct {
+  struct ppt_ctx* ctx;
+  HV* states;                 /* interned state strings */
+  int accessors;              /* have the accessors been installed */
+} my_cxt_t;
 
-/* This holds a pointer to the list of process objects we will build */
-AV* Proclist;
+START_MY_CXT
+
+/* The sampler thread (see below) has no interpreter; Sampler_key    */
+/* holds its scan so bless_into_proc and ppt_warn can tell.           */
+#ifdef PROCESSTABLE_SAMPLER
+static pthread_key_t Sampler_key;
+#define sampler_ctx() ((struct ppt_ctx*) pthread_getspecific(Sampler_key))
+#else
+#define sampler_ctx() NULL
+#endif
 
 /* Our local varargs warn which can be called as extern by code
  * that doesn't know Perl internals (and thus doesn't have a
@@ -56,10 +76,16 @@ AV* Proclist;
  * seem to accept format args.
  */
 void ppt_warn(const char *pat, ...) {
-    dTHX;
     va_list args;
     va_start(args, pat);
-    vwarn(pat, &args);
+    if( sampler_ctx() != NULL ){
+      vfprintf(stderr, pat, args);
+      fputc('\n', stderr);
+    }
+    else{
+      dTHX;
+      vwarn(pat, &args);
+    }
     va_end(args);
 }
 
@@ -72,30 +98,139 @@ void ppt_croak(const char *pat, ...) {
     va_end(args);
 }
 
-/* Look up the tty device, given the ttynum and store it */
-void store_ttydev( HV* myhash, unsigned long ttynum ){
+/* Strings that repeat across processes (the same fname, exec or cwd  */
+/* for thousands of workers, the handful of states and ttys) are      */
+/* interned: their SVs share one buffer from perl's shared string     */
+/* table, which is copied on write if someone modifies a value. The   */
+/* state strings are a small fixed set and are kept in States for     */
+/* good (per interpreter), so they aren't hashed and freed again with */
+/* every table.                                                       */
+static const char* const intern_fields[] = {
+  "fname", "exec", "cwd", "cmndline", "state", "ttydev", NULL
+};
+char* Intern = NULL; /* flag per entry of Fields */
+
+void intern_init(char** fields, int nfields){
+  int i, j;
+
+  Intern = (char*) calloc(nfields, 1);
+  if( Intern == NULL )
+    return;
+  for( i = 0; i < nfields; i++ )
+    for( j = 0; intern_fields[j] != NULL; j++ )
+      if( !strcmp(fields[i], intern_fields[j]) )
+        Intern[i] = strcmp(fields[i], "state") ? 1 : 2;
+}
+
+SV* intern_sv(const char* pv, STRLEN len, int keep){
+  dTHX;
+  dMY_CXT;
+  SV** svp;
+
+  if( !keep )
+    return newSVpvn_share(pv, len, 0);
+
+  if( MY_CXT.states == NULL )
+    MY_CXT.states = newHV();
+  svp = hv_fetch(MY_CXT.states, pv, len, 0);
+  if( svp == NULL )
+    svp = hv_store(MY_CXT.states, pv, len, newSVpvn_share(pv, len, 0), 0);
+  return newSVpvn_share(pv, len, SvSHARED_HASH(*svp));
+}
+
+/* Look up the tty device, given the ttynum */
+SV* ttydev_sv( HV* ttydevs, unsigned long ttynum ){
+  dTHX;
   SV** ttydev;
+  const char* dev;
+  STRLEN len;
   char ttynumbuf[1024]; 
   
   sprintf(ttynumbuf, "%lu", ttynum);
   if( 
-     Ttydevs != NULL &&
-     (ttydev = hv_fetch(Ttydevs, ttynumbuf, strlen(ttynumbuf), 0)) != NULL 
+     ttydevs != NULL &&
+     (ttydev = hv_fetch(ttydevs, ttynumbuf, strlen(ttynumbuf), 0)) != NULL 
      ){
-    hv_store(myhash, "ttydev", strlen("ttydev"), newSVsv(*ttydev), 0); 
+    dev = SvPV(*ttydev, len);
+    return intern_sv(dev, len, 0);
   }
   else{
-    /* hv_store(myhash, "ttydev", strlen("ttydev"), newSV(0), 0); */ 
+    /* return newSV(0); */ 
 
 /*     Stuff an empty string into the hash if there is no tty; this */
 /*     way the ttydev method won't return undef for nonexistent ttys. I'm */
 /*     not sure if this is really the right behavior... */
 
-    hv_store(myhash, "ttydev", strlen("ttydev"), newSVpv("",0), 0); 
+    return intern_sv("", 0, 0);
 
   }
 }
 
+/* Look up the tty device, given the ttynum and store it */
+void store_ttydev( HV* ttydevs, HV* myhash, unsigned long ttynum ){
+  hv_store(myhash, "ttydev", strlen("ttydev"), ttydev_sv(ttydevs, ttynum), 0); 
+}
+
+/**********************************************************************/
+/* Process records                                                    */
+/*                                                                    */
+/* bless_into_proc() no longer builds the perl hash right away; it    */
+/* copies the values the OS code passed in into a ppt_rec and hands   */
+/* that to the collect sink of the current scan. table() uses a sink  */
+/* that blesses every record into its Table array, the query methods  */
+/* further down use sinks that only keep what they need.              */
+/**********************************************************************/
+typedef struct {
+  char fmt;                   /* format char, as passed to bless_into_proc */
+  union {
+    IV iv;                    /* i, l, j */
+    UV uv;                    /* u, p */
+    SV *sv;                   /* V */
+    struct {
+      char *pv;
+      int len;                /* length without the trailing '\0' */
+    } str;                    /* s, a */
+  } u;
+} ppt_val;
+
+typedef struct {
+  char** fields;              /* field names, owned by the OS code */
+  int nvals;
+  ppt_val vals[1];            /* nvals values, string data follows */
+} ppt_rec;
+
+void ppt_rec_free(ppt_rec*);
+SV* lazy_array_sv(const char*, int);
+void install_accessors(char**, int);
+void mutex_table(int);
+
+/* A scan: the XS methods set one up on their stack and run the OS    */
+/* code with it as the current scan of the interpreter (ppt_scan).    */
+typedef struct ppt_snap ppt_snap;
+
+typedef struct ppt_ctx {
+  void (*collect)(struct ppt_ctx*, ppt_rec*); /* where the records go */
+  void* data;                 /* state of the collect sink */
+  AV* proclist;               /* the objects table() builds */
+  ppt_snap* snap;             /* the snapshot table() fills */
+  HV* ttydevs;                /* %Proc::ProcessTable::TTYDEVS */
+} ppt_ctx;
+
+/* Records and snapshots are also built by the sampler thread (see   */
+/* below), which has no perl interpreter, so they come from the C     */
+/* allocator.                                                         */
+static void* ppt_realloc(void* ptr, size_t size){
+  if( (ptr = realloc(ptr, size ? size : 1)) == NULL ){
+    fputs("Out of memory!\n", stderr);
+    exit(1);
+  }
+  return ptr;
+}
+
+#define PptNew(p, n, t)    ((p) = (t*) ppt_realloc(NULL, (n) * sizeof(t)))
+#define PptNewz(p, n, t)   (PptNew(p, n, t), Zero(p, n, t))
+#define PptRenew(p, n, t)  ((p) = (t*) ppt_realloc(p, (n) * sizeof(t)))
+#define PptFree(p)         free(p)
 
 /**********************************************************************/
 /* This gets called by OS-specific get_table                          */
@@ -118,299 +253,4409 @@ void store_ttydev( HV* myhash, unsigned long ttynum ){
 /*   p    unsigned long                                               */
 /* fields is an array of pointers to field names                      */
 /* following that is a var args list of field values                  */
+/* On the sampler thread, which has no interpreter, V values are left */
+/* out and a bad format gives NULL instead of a croak.                */
 /**********************************************************************/
-void bless_into_proc(char* format, char** fields, ...){
-  va_list args;
-  char* key;
-  char* s_val;
-  SV *SV_val;
-  int i_val;
-  unsigned u_val;
-  long l_val;
-  unsigned long p_val;
-  long long ll_val;
+ppt_rec* ppt_rec_new(char* format, char** fields, va_list args){
+  ppt_rec *rec;
+  ppt_val *val;
+  char *s;
+  int nvals, i;
+  int sampler = sampler_ctx() != NULL;
+  size_t strsize = 0;
 
-  HV* myhash;
-  SV* ref;
-  HV* mystash;
-  SV* blessed;
-
-  /* Blech */
-  if(Fields == NULL){
-    Fields = fields; 
-    Numfields = strlen(format);
-  }
-
-  myhash = newHV(); /* create a perl hash */
+  nvals = strlen(format);
+  rec = (ppt_rec*) ppt_realloc(NULL, sizeof(ppt_rec) + nvals * sizeof(ppt_val));
+  rec->fields = fields;
+  rec->nvals = nvals;
 
-  va_start(args, fields);
-  while( *format ){
-    key = *fields; 
-    switch(*format)
+  /* first pass: pick up the values, strings still point into the
+     caller's memory */
+  for( i = 0; i < nvals; i++ ){
+    val = &rec->vals[i];
+    val->fmt = format[i];
+    switch(format[i])
       {
-      case 'A': /* ignore; creates an undef value for this key in the hash */
+      case 'A':
 	va_arg(args, char *);
 	va_arg(args, int);
-	hv_store(myhash, key, strlen(key), &PL_sv_undef, 0);
 	break;
-      case 'a':  /* string */
-	s_val = va_arg(args, char *);
-	i_val = va_arg(args, int);
-	{
-	    int len;
-	    char *s;
-	    AV *av = newAV();
-
-	    for (s = s_val; s < (s_val + i_val); s += len + 1) {
-		len = strlen(s);
-		av_push (av, newSVpvn (s, len));
-	    }
-	    hv_store (myhash, key, strlen(key), newRV_noinc((SV *) av), 0);
-	}
+      case 'a':
+	val->u.str.pv = va_arg(args, char *);
+	val->u.str.len = va_arg(args, int);
+	strsize += val->u.str.len + 1;
 	break;
 
-      case 'S': /* ignore; creates an undef value for this key in the hash */
+      case 'S':
 	va_arg(args, char *);
-	hv_store(myhash, key, strlen(key), newSV(0), 0);
 	break;
-      case 's':  /* string */
-	s_val = va_arg(args, char *);
-	hv_store(myhash, key, strlen(key), newSVpv(s_val, strlen(s_val)), 0);
+      case 's':
+	val->u.str.pv = va_arg(args, char *);
+	val->u.str.len = strlen(val->u.str.pv);
+	strsize += val->u.str.len + 1;
 	break;
 
-      case 'I':  /* ignore; creates an undef value for this key in the hash */
+      case 'I':
 	va_arg(args, int);
-	hv_store(myhash, key, strlen(key), newSV(0), 0);
 	break;
-      case 'i':  /* int */
-	i_val = va_arg(args, int);
-	hv_store(myhash, key, strlen(key), newSViv(i_val), 0);
-
-	/* Look up and store the tty if this is ttynum */
-	if( !strcmp(key, "ttynum") ) store_ttydev( myhash, i_val );
+      case 'i':
+	val->u.iv = va_arg(args, int);
 	break;
 
-      case 'U':  /* ignore; creates an undef value for this key in the hash */
-	va_arg(args, unsigned );
-	hv_store(myhash, key, strlen(key), newSV(0), 0);
+      case 'U':
+	va_arg(args, unsigned);
 	break;
-      case 'u':  /* int */
-	u_val = va_arg(args, unsigned);
-	hv_store(myhash, key, strlen(key), newSVuv(u_val), 0);
+      case 'u':
+	val->u.uv = va_arg(args, unsigned);
 	break;
 
-      case 'L':  /* ignore; creates an undef value for this key in the hash */
+      case 'L':
 	va_arg(args, long);
-	hv_store(myhash, key, strlen(key), newSV(0), 0);
 	break;
-      case 'l':  /* long */
-	l_val = va_arg(args, long);
-	hv_store(myhash, key, strlen(key), newSVnv(l_val), 0);
-	/* Look up and store the tty if this is ttynum */
-	if( !strcmp(key, "ttynum") ) store_ttydev( myhash, l_val );
+      case 'l':
+	val->u.iv = va_arg(args, long);
 	break;
 
-      case 'P':  /* ignore; creates an undef value for this key in the hash */
+      case 'P':
 	va_arg(args, unsigned long);
-	hv_store(myhash, key, strlen(key), newSV(0), 0);
 	break;
-      case 'p':  /* unsigned long */
-	p_val = va_arg(args, unsigned long);
-	hv_store(myhash, key, strlen(key), newSVnv(p_val), 0);
+      case 'p':
+	val->u.uv = va_arg(args, unsigned long);
 	break;
 
-      case 'J':  /* ignore; creates an undef value for this key in the hash */
+      case 'J':
 	va_arg(args, long long);
-	hv_store(myhash, key, strlen(key), newSV(0), 0);
 	break;
-      case 'j':  /* long long */
-	ll_val = va_arg(args, long long);
-	hv_store(myhash, key, strlen(key), newSVnv(ll_val), 0);
+      case 'j':
+	val->u.iv = va_arg(args, long long);
 	break;
 
-      case 'V':  /* perl scalar value */
-	SV_val = va_arg(args, SV *);
-	hv_store(myhash, key, strlen(key), SV_val, 0);
+      case 'V':
+	val->u.sv = va_arg(args, SV *);
+	/* no reference count to take over without an interpreter */
+	if( sampler )
+	  val->fmt = 'S';
 	break;
 
       default:
-	croak("Unknown data format type `%c' returned from OS_get_table", *format);
-	va_end(args); 
+	rec->nvals = i;
+	ppt_rec_free(rec);
+	if( sampler ){
+	  ppt_warn("Unknown data format type `%c' returned from OS_get_table", format[i]);
+	  return NULL;
+	}
+	croak("Unknown data format type `%c' returned from OS_get_table", format[i]);
       }
-    
-    format++;
-    fields++;
   }
 
-  /* objectify the hash */
-  ref = newRV_noinc((SV*) myhash);                        /* create ref from hash pointer */
-  mystash = gv_stashpv("Proc::ProcessTable::Process", 1); /* create symbol table for this obj */
-  blessed = sv_bless(ref, mystash);                       /* bless it */
-  /* push it onto the array */
-  av_push(Proclist, blessed);
+  /* second pass: copy the strings behind the values, so the record is
+     a single allocation */
+  if( strsize ){
+    rec = (ppt_rec*) ppt_realloc(rec, sizeof(ppt_rec) + nvals * sizeof(ppt_val) + strsize);
+    s = (char*) &rec->vals[nvals];
+    for( i = 0; i < nvals; i++ ){
+      val = &rec->vals[i];
+      if( val->fmt == 's' || val->fmt == 'a' ){
+	memcpy(s, val->u.str.pv, val->u.str.len);
+	s[val->u.str.len] = '\0';
+	val->u.str.pv = s;
+	s += val->u.str.len + 1;
+      }
+    }
+  }
 
-  va_end(args);
+  return rec;
+}
+
+void ppt_rec_free(ppt_rec* rec){
+  int i;
+
+  /* the sampler thread can't touch perl values; its own records */
+  /* have none (see ppt_rec_new)                                 */
+  if( sampler_ctx() != NULL ){
+    PptFree(rec);
+    return;
+  }
+  for( i = 0; i < rec->nvals; i++ ){
+    if( rec->vals[i].fmt == 'V' ){
+      dTHX;
+      SvREFCNT_dec(rec->vals[i].u.sv);
+    }
+  }
+  PptFree(rec);
+}
+
+/* Look up a field by name, -1 if the OS code doesn't provide it */
+int ppt_rec_field(ppt_rec* rec, const char* name){
+  int i;
+
+  for( i = 0; i < rec->nvals; i++ ){
+    if( !strcmp(rec->fields[i], name) )
+      return i;
+  }
+  return -1;
+}
+
+/* Numeric value of a record value; false if it has none */
+static int ppt_val_num(ppt_val* val, NV* nv){
+  char *end;
+
+  switch(val->fmt)
+    {
+    case 'i': case 'l': case 'j':
+      *nv = (NV) val->u.iv;
+      return 1;
+    case 'u': case 'p':
+      *nv = (NV) val->u.uv;
+      return 1;
+    case 's':
+      *nv = strtod(val->u.str.pv, &end);
+      if( end == val->u.str.pv )
+	return 0;
+      while( isSPACE(*end) )
+	end++;
+      return *end == '\0';
+    }
+  return 0;
 }
 
 /**********************************************************************/
-/* Generic funcs generated by h2xs                                    */
+/* Lazy string arrays                                                 */
+/* Values of type 'a' (cmdline, environ) can hold thousands of        */
+/* strings, and most callers never look at them. They start out as a */
+/* scalar holding the raw '\0' separated buffer, with get magic that  */
+/* turns the scalar into a reference to the array of strings the      */
+/* first time it is read. argv() and env() find single strings in    */
+/* the raw buffer without building the array.                         */
 /**********************************************************************/
+static AV* nul_list_av(const char* buf, STRLEN buflen){
+  dTHX;
+  AV* av = newAV();
+  const char* s;
+  STRLEN len;
 
-static int
-not_here(s)
-char *s;
-{
-    croak("%s not implemented on this architecture", s);
-    return -1;
+  for( s = buf; s < buf + buflen; s += len + 1 ){
+    len = strlen(s);
+    av_push(av, newSVpvn(s, len));
+  }
+  return av;
 }
 
-static double
-constant(name, arg)
-char *name;
-int arg;
-{
-    errno = 0;
-    switch (*name) {
-    }
-    errno = EINVAL;
+static int lazy_array_get(pTHX_ SV* sv, MAGIC* mg){
+  AV* av;
+  SV* rv;
+
+  /* mg_private is set once the array is built */
+  if( mg->mg_private )
     return 0;
+  mg->mg_private = 1;
 
-not_there:
-    errno = ENOENT;
+  av = nul_list_av(SvPVX(sv), SvCUR(sv));
+  rv = newRV_noinc((SV*) av);
+  sv_setsv(sv, rv);
+  SvREFCNT_dec(rv);
+  return 0;
+}
+
+/* Whatever the caller stores replaces the raw buffer for good */
+static int lazy_array_set(pTHX_ SV* sv, MAGIC* mg){
+  mg->mg_private = 1;
+  return 0;
+}
+
+static MGVTBL lazy_array_vtbl = { lazy_array_get, lazy_array_set, 0, 0, 0 };
+
+SV* lazy_array_sv(const char* buf, int len){
+  dTHX;
+  SV* sv = newSVpvn(buf, len);
+
+  sv_magicext(sv, NULL, PERL_MAGIC_ext, &lazy_array_vtbl, NULL, 0);
+  return sv;
+}
+
+/* The raw buffer of a lazy array that hasn't been built yet */
+static int lazy_array_raw(SV* sv, const char** buf, STRLEN* len){
+  dTHX;
+  MAGIC* mg;
+
+  if( SvTYPE(sv) < SVt_PVMG || (mg = mg_findext(sv, PERL_MAGIC_ext, &lazy_array_vtbl)) == NULL ||
+      mg->mg_private )
     return 0;
+  *buf = SvPVX(sv);
+  *len = SvCUR(sv);
+  return 1;
 }
 
-#ifdef	PROCESSTABLE_THREAD
-pthread_mutex_t _mutex_table;
-pthread_mutex_t _mutex_new;
+/* Number of strings in a '\0' separated buffer */
+static int nul_list_count(const char* buf, STRLEN buflen){
+  const char* s;
+  int n = 0;
 
-void
-mutex_op(int lock, pthread_mutex_t *mutex)
-{
-	if (lock == 0) {	/*unlock*/
-		pthread_mutex_unlock(mutex);
-	} else {		/*lock*/
-		pthread_mutex_lock(mutex);
-	}
+  for( s = buf; s < buf + buflen; s += strlen(s) + 1 )
+    n++;
+  return n;
+}
+
+/* The i-th string of a '\0' separated buffer, negative i count from the
+   end; NULL if there is none */
+static SV* nul_list_nth(const char* buf, STRLEN buflen, IV i){
+  dTHX;
+  const char* s;
+
+  if( i < 0 )
+    i += nul_list_count(buf, buflen);
+  if( i < 0 )
+    return NULL;
+  for( s = buf; s < buf + buflen; s += strlen(s) + 1 ){
+    if( i-- == 0 )
+      return newSVpv(s, 0);
+  }
+  return NULL;
+}
+
+/* The value of NAME in a '\0' separated list of NAME=value strings */
+static SV* nul_list_env(const char* buf, STRLEN buflen, const char* name, STRLEN namelen){
+  dTHX;
+  const char* s;
+
+  for( s = buf; s < buf + buflen; s += strlen(s) + 1 ){
+    if( !strncmp(s, name, namelen) && s[namelen] == '=' )
+      return newSVpv(s + namelen + 1, 0);
+  }
+  return NULL;
+}
+
+/* The same for arrays that are already built (or were set by the
+   caller) */
+static SV* av_env(AV* av, const char* name, STRLEN namelen){
+  dTHX;
+  SV** elem;
+  const char* s;
+  STRLEN len;
+  I32 i;
+
+  for( i = 0; i <= av_len(av); i++ ){
+    if( (elem = av_fetch(av, i, 0)) == NULL || !SvOK(*elem) )
+      continue;
+    s = SvPV(*elem, len);
+    if( len > namelen && !strncmp(s, name, namelen) && s[namelen] == '=' )
+      return newSVpvn(s + namelen + 1, len - namelen - 1);
+  }
+  return NULL;
+}
+
+/* argv() and env() on a cmdline or environ value */
+static SV* lazy_array_lookup(SV* sv, SV* what, int env){
+  dTHX;
+  const char* buf;
+  const char* name;
+  STRLEN len, namelen;
+  SV** elem;
+  SV* found = NULL;
+
+  if( lazy_array_raw(sv, &buf, &len) ){
+    if( env ){
+      name = SvPV(what, namelen);
+      found = nul_list_env(buf, len, name, namelen);
+    }
+    else{
+      found = nul_list_nth(buf, len, SvIV(what));
+    }
+  }
+  else{
+    SvGETMAGIC(sv);
+    if( SvROK(sv) && SvTYPE(SvRV(sv)) == SVt_PVAV ){
+      if( env ){
+	name = SvPV(what, namelen);
+	found = av_env((AV*) SvRV(sv), name, namelen);
+      }
+      else if( (elem = av_fetch((AV*) SvRV(sv), SvIV(what), 0)) != NULL ){
+	found = newSVsv(*elem);
+      }
+    }
+  }
+  return found ? found : &PL_sv_undef;
+}
+
+/* Build the perl value for a record value */
+SV* ppt_val_sv(ppt_val* val){
+  dTHX;
+
+  switch(val->fmt)
+    {
+    case 'A': /* ignore; creates an undef value for this key in the hash */
+      return &PL_sv_undef;
+    case 'a':  /* array of strings, built when first read */
+      return lazy_array_sv(val->u.str.pv, val->u.str.len);
+
+    case 's':  /* string */
+      return newSVpvn(val->u.str.pv, val->u.str.len);
+
+    case 'i':  /* int */
+      return newSViv(val->u.iv);
+
+    case 'u':  /* int */
+      return newSVuv(val->u.uv);
+
+    case 'l':  /* long */
+    case 'j':  /* long long */
+      return newSVnv(val->u.iv);
+
+    case 'p':  /* unsigned long */
+      return newSVnv(val->u.uv);
+
+    case 'V':  /* perl scalar value */
+      return SvREFCNT_inc(val->u.sv);
+    }
+
+  /* S, I, U, L, P, J: creates an undef value for this key in the hash */
+  return newSV(0);
+}
+
+/* Build a Proc::ProcessTable::Process object from a record */
+SV* ppt_rec_bless(HV* ttydevs, ppt_rec* rec){
+  dTHX;
+  char* key;
+  ppt_val* val;
+  HV* myhash;
+  SV* ref;
+  HV* mystash;
+  int i;
+
+  myhash = newHV(); /* create a perl hash */
+
+  for( i = 0; i < rec->nvals; i++ ){
+    key = rec->fields[i];
+    val = &rec->vals[i];
+    if( val->fmt == 's' && Intern != NULL && Intern[i] && rec->fields == Fields )
+      hv_store(myhash, key, strlen(key),
+               intern_sv(val->u.str.pv, val->u.str.len, Intern[i] == 2), 0);
+    else
+      hv_store(myhash, key, strlen(key), ppt_val_sv(val), 0);
+
+    /* Look up and store the tty if this is ttynum */
+    if( (val->fmt == 'i' || val->fmt == 'l') && !strcmp(key, "ttynum") )
+      store_ttydev( ttydevs, myhash, val->u.iv );
+  }
+
+  /* objectify the hash */
+  ref = newRV_noinc((SV*) myhash);                        /* create ref from hash pointer */
+  mystash = gv_stashpv("Proc::ProcessTable::Process", 1); /* create symbol table for this obj */
+  return sv_bless(ref, mystash);                          /* bless it */
 }
+
+/**********************************************************************/
+/* Field schema                                                       */
+/* OS code that defines PROCESSTABLE_OS_FIELDS can tell its fields,   */
+/* their types and units without reading the process table; for the  */
+/* rest they are learned from the first record.                       */
+/**********************************************************************/
+#ifdef PROCESSTABLE_OS_FIELDS
+char** OS_get_fields(char**, const char* const**);
 #endif
 
-void
-mutex_new(int lock)
-{
-#ifdef	PROCESSTABLE_THREAD
-	mutex_op(lock, &_mutex_new);
+static void fields_init(char* format, char** fields){
+#ifdef PROCESSTABLE_OS_FIELDS
+  char* os_format;
+
+  OS_get_fields(&os_format, &Units);
 #endif
+  Numfields = strlen(format);
+  Format = (char*) malloc(Numfields + 1);
+  if( Format != NULL )
+    strcpy(Format, format);
+  intern_init(fields, Numfields);
+  Fields = fields; 
 }
 
-void
-mutex_table(int lock)
-{
-#ifdef	PROCESSTABLE_THREAD
-	mutex_op(lock, &_mutex_table);
-#endif
+#ifdef PROCESSTABLE_OS_FIELDS
+static void fields_os_init(void){
+  char* format;
+  const char* const* units;
+  char** fields;
+
+  fields = OS_get_fields(&format, &units);
+  fields_init(format, fields);
 }
 
-MODULE = Proc::ProcessTable		PACKAGE = Proc::ProcessTable		
-PROTOTYPES: DISABLE
+/* Set up Fields, Format and Intern from the OS code, just once. BOOT */
+/* does this, before any other thread can scan: bless_into_proc()     */
+/* runs without the table lock then (see mutex_table).               */
+static void fields_os(void){
+#if defined(PROCESSTABLE_THREAD) || defined(PROCESSTABLE_SAMPLER)
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
 
-BOOT:
-#ifdef	PROCESSTABLE_THREAD
-	pthread_mutex_init(&_mutex_table, NULL);
-	pthread_mutex_init(&_mutex_new, NULL);
+  pthread_once(&once, fields_os_init);
+#else
+  if( Fields == NULL )
+    fields_os_init();
+#endif
+}
 #endif
 
-void
-mutex_new(lock)
-	int lock
+/* Make sure Fields is known, reading a table if need be */
+static void fields_need(SV* obj){
+  dTHX;
+#ifdef PROCESSTABLE_OS_FIELDS
+  fields_os();
+#else
+  dSP;
 
-void
-mutex_table(lock)
-	int lock
+  if( Fields == NULL ){
+    PUSHMARK(SP);
+    XPUSHs(obj);
+    PUTBACK;
+    call_method("table", G_DISCARD);
+  }
+#endif
+}
 
-double
-constant(name,arg)
-	char *		name
-	int		arg
+/* The type of a field, from its format letter */
+static const char* field_type(char fmt){
+  switch(toLOWER(fmt))
+    {
+    case 'i': case 'u':
+      return "int";
+    case 'l': case 'j': case 'p':
+      return "long";
+    case 's':
+      return "string";
+    case 'a':
+      return "array";
+    }
+  return "scalar";
+}
 
-SV*
-table(obj)
-     SV*  obj
-     CODE:
+void bless_into_proc(char* format, char** fields, ...){
+  ppt_ctx* ctx;
+  va_list args;
+  ppt_rec* rec;
 
-     /* Check that we have an actual object. 
-       calling Proc::Processtable->table SIGSEVs
-       calling on an actual object is valid my $proc_obj = Proc::ProcessTable->new; $proc_obj->table; 
-     */
-     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
-         croak("Must call table from an initalized object created with new");
-     }
+  /* Blech */
+  if(Fields == NULL)
+    fields_init(format, fields);
 
+  if( (ctx = sampler_ctx()) == NULL ){
+    dTHX;
+    dMY_CXT;
 
-     HV* hash;
-     SV** fetched;
+    if( !MY_CXT.accessors ){
+      install_accessors(Fields, Numfields);
+      MY_CXT.accessors = 1;
+    }
+    /* not called from a scan */
+    if( (ctx = MY_CXT.ctx) == NULL )
+      return;
+  }
 
+  va_start(args, fields);
+  rec = ppt_rec_new(format, fields, args);
+  va_end(args);
 
-     mutex_table(1);
-     /* Cache a pointer to the tty device hash */ 
-     Ttydevs = perl_get_hv("Proc::ProcessTable::TTYDEVS", FALSE);
+  if( rec != NULL )
+    ctx->collect(ctx, rec);
+}
 
-     /* dereference our object to a hash */
-     hash = (HV*) SvRV(obj);
+/* Run the OS code for a scan; for a single process if pid isn't -1  */
+/* and the OS code can do that (see $p->refresh). Where it can, only  */
+/* the fields in names are read, if that isn't NULL.                  */
+#ifdef PROCESSTABLE_GET_PROC
+int OS_get_proc(long, char**, int);
+#endif
 
-     /* If the Table array already exists on our object we clear it
-        and store a pointer to it in Proclist */
-     if( hv_exists(hash, "Table", 5) ){
-       /* fetch the hash entry */
-       fetched = hv_fetch(hash, "Table", 5, 0);
-       /* what's stored in the hash is a ref to the array, so we need
-          to dereference it */
-       Proclist = (AV*) SvRV(*fetched);
-       av_clear(Proclist);
-     }
-     else{
-       /* Otherwise we create the array and store it on the object. */
-       Proclist = newAV();
-       hv_store(hash, "Table", 5, newRV_noinc((SV*)Proclist), 0);
-     }
+static void ppt_scan(ppt_ctx* ctx, long pid, char** names, int nnames){
+  dTHX;
+  dMY_CXT;
+  ppt_ctx* outer = MY_CXT.ctx;
 
-     /* Call get_table to build the process objects and push them onto
-        the Proclist */
-     OS_get_table();
+  ctx->ttydevs = perl_get_hv("Proc::ProcessTable::TTYDEVS", FALSE);
+  mutex_table(1);
+  MY_CXT.ctx = ctx;
+#ifdef PROCESSTABLE_GET_PROC
+  if( pid != -1 || names != NULL )
+    OS_get_proc(pid, names, nnames);
+  else
+#endif
+  OS_get_table();
+  MY_CXT.ctx = outer;
+  mutex_table(0);
+}
 
-     /* Return a ref to our process list */
-     RETVAL = newRV_inc((SV*) Proclist);
+/**********************************************************************/
+/* Snapshots                                                          */
+/* table() keeps a small C side description of the table it built in */
+/* $self->{Snapshot}: the pid and ppid of each process, in the order  */
+/* of the Table array, an open addressing pid -> index map and the    */
+/* process tree. The map has twice as many slots as there are         */
+/* processes, so its size doesn't depend on pid_max. The tree is kept */
+/* as adjacency lists in one array: the children of process i are     */
+/* kids[kids_at[i]] up to kids[kids_at[i + 1]]. For the subtree       */
+/* rollup the snapshot also keeps the resource columns listed in      */
+/* roll_fields.                                                       */
+/*                                                                    */
+/* table(packed => 1) builds no Table array at all; its snapshot      */
+/* keeps the records themselves and is returned to the caller, who    */
+/* gets thin Proc::ProcessTable::Process::View objects (snapshot +    */
+/* index) from it that read straight from the records.                */
+/**********************************************************************/
+#define NROLL 5
 
-     mutex_table(0);
-     
-     OUTPUT:
-     RETVAL
+static const char* const roll_fields[NROLL] =
+{
+    "rss",
+    "size",
+    "time",
+    "minflt",
+    "majflt"
+};
 
-void
-fields(obj)
-     SV*  obj
-     PPCODE:
+struct ppt_snap {
+  int n;                      /* number of processes */
+  int max;
+  IV* pid;
+  IV* ppid;
+  NV* start;                  /* start times, 0 if the OS has none */
+  int f_pid, f_ppid, f_start; /* field indices, resolved on the first record */
+  int f_roll[NROLL];
+  NV* roll[NROLL];            /* resource columns, 0 for missing values */
+  int resolved;
+  int* slots;                 /* process index + 1, 0 for empty slots */
+  int nslots;                 /* a power of two */
+  int* parent;                /* process index of the parent, -1 if unknown */
+  int* kids_at;               /* n + 1 offsets into kids */
+  int* kids;
+  ppt_rec** recs;             /* the records, for packed snapshots only */
+  int packed;
+  NV* tree[NROLL];            /* rollup() results */
+  int* tree_count;            /* processes in the subtree, 0 if not rolled up */
+  int rolled;                 /* are tree and tree_count valid for this scan */
+  int refcnt;                 /* Snapshot objects and the sampler holding it */
+};
 
-     /* see above.  This should be called on an object generated by new */
-     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
-         croak("Must call fields from an initalized object created with new");
-     }
+static ppt_snap* snap_new(int packed){
+  ppt_snap* snap;
 
-     int i;
-     SV* my_sv;
+  PptNewz(snap, 1, ppt_snap);
+  snap->packed = packed;
+  snap->refcnt = 1;
+  return snap;
+}
 
-     if( Fields == NULL ){
-       PUSHMARK(SP);
-       XPUSHs(obj);
-       PUTBACK;
-       perl_call_method("table", G_DISCARD);
-     }
+static void snap_free_recs(ppt_snap* snap){
+  int i;
 
-     EXTEND(SP,Numfields);
-     for (i=0; i < Numfields; i++ ){
-       my_sv = newSVpv(Fields[i],0);
-       PUSHs(sv_2mortal(my_sv));
-     }
+  if( snap->recs ){
+    for( i = 0; i < snap->n; i++ )
+      ppt_rec_free(snap->recs[i]);
+  }
+}
+
+static void snap_free(ppt_snap* snap){
+  int i;
+
+  snap_free_recs(snap);
+  PptFree(snap->recs);
+  PptFree(snap->tree_count);
+  for( i = 0; i < NROLL; i++ )
+    PptFree(snap->tree[i]);
+  PptFree(snap->pid);
+  PptFree(snap->ppid);
+  PptFree(snap->start);
+  PptFree(snap->slots);
+  PptFree(snap->parent);
+  PptFree(snap->kids_at);
+  PptFree(snap->kids);
+  for( i = 0; i < NROLL; i++ )
+    PptFree(snap->roll[i]);
+  PptFree(snap);
+}
+
+/* Snapshots the sampler publishes are shared between its thread and */
+/* the Snapshot objects, so their count changes atomically             */
+#ifdef PROCESSTABLE_SAMPLER
+#define snap_refcnt_inc(snap)  __sync_add_and_fetch(&(snap)->refcnt, 1)
+#define snap_refcnt_dec(snap)  __sync_sub_and_fetch(&(snap)->refcnt, 1)
+#else
+#define snap_refcnt_inc(snap)  (++(snap)->refcnt)
+#define snap_refcnt_dec(snap)  (--(snap)->refcnt)
+#endif
+
+static void snap_release(ppt_snap* snap){
+  if( snap_refcnt_dec(snap) == 0 )
+    snap_free(snap);
+}
+
+/* Start over for a new scan, keeping the allocations */
+static void snap_reset(ppt_snap* snap){
+  snap_free_recs(snap);
+  snap->n = 0;
+  snap->resolved = 0;
+  snap->rolled = 0;
+}
+
+/* A pid valued field of a record, -1 if there is none */
+static IV ppt_rec_pid(ppt_rec* rec, int idx){
+  ppt_val* val;
+
+  if( idx < 0 )
+    return -1;
+  val = &rec->vals[idx];
+  switch(val->fmt)
+    {
+    case 'i': case 'l': case 'j':
+      return val->u.iv;
+    case 'u': case 'p':
+      return (IV) val->u.uv;
+    }
+  return -1;
+}
+
+static void snap_add(ppt_snap* snap, ppt_rec* rec){
+  NV nv;
+  int i;
+
+  if( !snap->resolved ){
+    snap->f_pid = ppt_rec_field(rec, "pid");
+    snap->f_ppid = ppt_rec_field(rec, "ppid");
+    snap->f_start = ppt_rec_field(rec, "start");
+    for( i = 0; i < NROLL; i++ )
+      snap->f_roll[i] = ppt_rec_field(rec, roll_fields[i]);
+    snap->resolved = 1;
+  }
+  if( snap->n == snap->max ){
+    snap->max = snap->max ? snap->max * 2 : 256;
+    PptRenew(snap->pid, snap->max, IV);
+    PptRenew(snap->ppid, snap->max, IV);
+    PptRenew(snap->start, snap->max, NV);
+    PptRenew(snap->parent, snap->max, int);
+    PptRenew(snap->kids, snap->max, int);
+    PptRenew(snap->kids_at, snap->max + 1, int);
+    for( i = 0; i < NROLL; i++ )
+      PptRenew(snap->roll[i], snap->max, NV);
+    if( snap->packed )
+      PptRenew(snap->recs, snap->max, ppt_rec*);
+  }
+
+  snap->pid[snap->n] = ppt_rec_pid(rec, snap->f_pid);
+  snap->ppid[snap->n] = ppt_rec_pid(rec, snap->f_ppid);
+  if( snap->f_start < 0 || !ppt_val_num(&rec->vals[snap->f_start], &nv) )
+    nv = 0;
+  snap->start[snap->n] = nv;
+  for( i = 0; i < NROLL; i++ ){
+    if( snap->f_roll[i] < 0 || !ppt_val_num(&rec->vals[snap->f_roll[i]], &nv) )
+      nv = 0;
+    snap->roll[i][snap->n] = nv;
+  }
+  if( snap->packed )
+    snap->recs[snap->n] = rec;
+  snap->n++;
+}
+
+static U32 snap_pid_hash(IV pid){
+  return (U32) pid * 2654435761U;
+}
+
+static int snap_find(ppt_snap* snap, IV pid);
+
+/* Build the pid -> index map and the tree once the scan is done */
+static void snap_finish(ppt_snap* snap){
+  int nslots, i, j;
+
+  for( nslots = 64; nslots < snap->n * 2; nslots *= 2 )
+    ;
+  if( nslots != snap->nslots ){
+    PptFree(snap->slots);
+    PptNew(snap->slots, nslots, int);
+    snap->nslots = nslots;
+  }
+  Zero(snap->slots, nslots, int);
+
+  for( i = 0; i < snap->n; i++ ){
+    if( snap->pid[i] < 0 )
+      continue;
+    for( j = snap_pid_hash(snap->pid[i]) & (nslots - 1); snap->slots[j]; j = (j + 1) & (nslots - 1) )
+      ;
+    snap->slots[j] = i + 1;
+  }
+
+  if( snap->n == 0 )
+    return;
+
+  /* count the children of each process, then turn the counts into
+     offsets and fill in the children back to front */
+  Zero(snap->kids_at, snap->n + 1, int);
+  for( i = 0; i < snap->n; i++ ){
+    j = snap->ppid[i] != snap->pid[i] ? snap_find(snap, snap->ppid[i]) : -1;
+    snap->parent[i] = j;
+    if( j >= 0 )
+      snap->kids_at[j]++;
+  }
+  for( i = 0, j = 0; i <= snap->n; i++ ){
+    j += snap->kids_at[i];
+    snap->kids_at[i] = j;
+  }
+  for( i = snap->n - 1; i >= 0; i-- ){
+    if( snap->parent[i] >= 0 )
+      snap->kids[--snap->kids_at[snap->parent[i]]] = i;
+  }
+}
+
+/* Index of pid in the snapshot, -1 if it isn't there */
+static int snap_find(ppt_snap* snap, IV pid){
+  int j, i;
+
+  if( snap->nslots == 0 )
+    return -1;
+  for( j = snap_pid_hash(pid) & (snap->nslots - 1); (i = snap->slots[j]) != 0; j = (j + 1) & (snap->nslots - 1) ){
+    if( snap->pid[i - 1] == pid )
+      return i - 1;
+  }
+  return -1;
+}
+
+/* Index in snap of process i of other, by pid and start time so a  */
+/* reused pid doesn't match; -1 if it isn't there                     */
+static int snap_match(ppt_snap* snap, ppt_snap* other, int i){
+  int j;
+
+  if( (j = snap_find(snap, other->pid[i])) >= 0 && snap->start[j] != other->start[i] )
+    j = -1;
+  return j;
+}
+
+/* Has any of the fields changed by more than its limit between two */
+/* records                                                            */
+static int ppt_rec_changed(ppt_rec* a, ppt_rec* b, int* idx, NV* limits, int n){
+  NV x, y;
+  int k;
+
+  for( k = 0; k < n; k++ ){
+    if( !ppt_val_num(&a->vals[idx[k]], &x) || !ppt_val_num(&b->vals[idx[k]], &y) )
+      continue;
+    if( (x > y ? x - y : y - x) > limits[k] )
+      return 1;
+  }
+  return 0;
+}
+
+/* The snapshot stored on a table object, NULL if there is none yet */
+static ppt_snap* snap_of(SV* obj){
+  dTHX;
+  SV** fetched;
+
+  fetched = hv_fetch((HV*) SvRV(obj), "Snapshot", 8, 0);
+  if( fetched == NULL || !sv_isa(*fetched, "Proc::ProcessTable::Snapshot") )
+    return NULL;
+  return INT2PTR(ppt_snap*, SvIV(SvRV(*fetched)));
+}
+
+/* Like snap_of, but reads a table first if there is no snapshot yet */
+static ppt_snap* snap_get(SV* obj){
+  dTHX;
+  dSP;
+  ppt_snap* snap;
+
+  if( (snap = snap_of(obj)) == NULL ){
+    PUSHMARK(SP);
+    XPUSHs(obj);
+    PUTBACK;
+    perl_call_method("table", G_DISCARD);
+    snap = snap_of(obj);
+  }
+  return snap;
+}
+
+/* A Proc::ProcessTable::Process::View of process i of a packed
+   snapshot */
+static SV* snap_view(SV* snap_sv, int i){
+  dTHX;
+  AV* view = newAV();
+
+  av_extend(view, 1);
+  av_store(view, 0, newSVsv(snap_sv));
+  av_store(view, 1, newSViv(i));
+  return sv_bless(newRV_noinc((SV*) view),
+		  gv_stashpv("Proc::ProcessTable::Process::View", 1));
+}
+
+/* The value of a field of process i of a packed snapshot, NULL if
+   there is no such field. Besides the fields of the records this knows
+   ttydev and the rollup() totals. */
+static SV* snap_field(ppt_snap* snap, int i, const char* name){
+  dTHX;
+  ppt_rec* rec = snap->recs[i];
+  int idx, j;
+
+  if( (idx = ppt_rec_field(rec, name)) >= 0 )
+    return ppt_val_sv(&rec->vals[idx]);
+
+  if( !strcmp(name, "ttydev") ){
+    if( (idx = ppt_rec_field(rec, "ttynum")) < 0 ||
+	(rec->vals[idx].fmt != 'i' && rec->vals[idx].fmt != 'l') )
+      return NULL;
+    return ttydev_sv(perl_get_hv("Proc::ProcessTable::TTYDEVS", FALSE),
+                     rec->vals[idx].u.iv);
+  }
+
+  if( !strncmp(name, "tree_", 5) && snap->rolled && snap->tree_count[i] ){
+    if( !strcmp(name + 5, "count") )
+      return newSViv(snap->tree_count[i]);
+    for( j = 0; j < NROLL; j++ ){
+      if( snap->f_roll[j] >= 0 && !strcmp(name + 5, roll_fields[j]) )
+	return newSVnv(snap->tree[j][i]);
+    }
+  }
+  return NULL;
+}
+
+/* The snapshot behind a Proc::ProcessTable::Snapshot object */
+static ppt_snap* snap_from_sv(SV* snap_sv){
+  dTHX;
+
+  if( !sv_isa(snap_sv, "Proc::ProcessTable::Snapshot") )
+    croak("Not a Proc::ProcessTable::Snapshot object");
+  return INT2PTR(ppt_snap*, SvIV(SvRV(snap_sv)));
+}
+
+/* Puts process i and its descendants into order, breadth first so
+   parents come before their children; returns how many there are.
+   order needs room for all processes. */
+static int snap_subtree(ppt_snap* snap, int i, int* order){
+  int head, tail, k;
+
+  head = tail = 0;
+  order[tail++] = i;
+  while( head < tail ){
+    i = order[head++];
+    for( k = snap->kids_at[i]; k < snap->kids_at[i + 1] && tail < snap->n; k++ )
+      order[tail++] = snap->kids[k];
+  }
+  return tail;
+}
+
+/* Subtree totals of the resource columns for the processes in order,
+   which must be closed under taking children (a subtree from
+   snap_subtree, or the whole table in parent first order). Walking it
+   backwards adds every process to its parent after all its children
+   were added to it. */
+static void snap_rollup(ppt_snap* snap, int* order, int norder){
+  NV** tree = snap->tree;
+  int* count;
+  int i, j, k;
+
+  if( !snap->rolled ){
+    PptRenew(snap->tree_count, snap->n + 1, int);
+    Zero(snap->tree_count, snap->n + 1, int);
+    for( j = 0; j < NROLL; j++ )
+      PptRenew(snap->tree[j], snap->n + 1, NV);
+    snap->rolled = 1;
+  }
+  count = snap->tree_count;
+
+  for( k = 0; k < norder; k++ ){
+    i = order[k];
+    count[i] = 1;
+    for( j = 0; j < NROLL; j++ )
+      tree[j][i] = snap->roll[j][i];
+  }
+  for( k = norder - 1; k > 0; k-- ){
+    i = order[k];
+    if( snap->parent[i] < 0 || i == order[0] )
+      continue;
+    count[snap->parent[i]] += count[i];
+    for( j = 0; j < NROLL; j++ )
+      tree[j][snap->parent[i]] += tree[j][i];
+  }
+}
+
+/* The table() sink: push every process onto the Table array */
+void collect_proclist(ppt_ctx* ctx, ppt_rec* rec){
+  dTHX;
+
+  av_push(ctx->proclist, ppt_rec_bless(ctx->ttydevs, rec));
+  if( ctx->snap )
+    snap_add(ctx->snap, rec);
+  ppt_rec_free(rec);
+}
+
+/* The table(packed => 1) sink: the snapshot keeps the records */
+void collect_packed(ppt_ctx* ctx, ppt_rec* rec){
+  snap_add(ctx->snap, rec);
+}
+
+/* A sink for just the process tree */
+void collect_tree(ppt_ctx* ctx, ppt_rec* rec){
+  snap_add(ctx->snap, rec);
+  ppt_rec_free(rec);
+}
+
+/**********************************************************************/
+/* Interval rates                                                     */
+/* $t->rates keeps the counters of its last scan per (pid, start) in  */
+/* a ppt_rates table and divides the differences by the time between  */
+/* the scans, on the monotonic clock. Like calc_prec, the CPU times   */
+/* are taken to be in microseconds.                                   */
+/**********************************************************************/
+#include <time.h>
+
+#define NRATE 5
+
+static const char* const rate_fields[NRATE] =
+{
+    "time",
+    "utime",
+    "stime",
+    "minflt",
+    "majflt"
+};
+
+/* What rates returns for each of them */
+static const char* const rate_keys[NRATE] =
+{
+    "pctcpu",
+    "pctuser",
+    "pctsys",
+    "minflt_rate",
+    "majflt_rate"
+};
+
+typedef struct ppt_rates {
+  int n;
+  int max;
+  IV* pid;
+  NV* start;
+  NV* vals[NRATE];            /* counters, -1 for missing values */
+  int f_pid, f_start;         /* field indices, resolved on the first record */
+  int f_vals[NRATE];
+  int resolved;
+  int* slots;                 /* process index + 1, 0 for empty slots */
+  int nslots;
+  NV when;                    /* monotonic time of the scan in seconds */
+} ppt_rates;
+
+static void rates_free(ppt_rates* r){
+  int i;
+
+  Safefree(r->pid);
+  Safefree(r->start);
+  for( i = 0; i < NRATE; i++ )
+    Safefree(r->vals[i]);
+  Safefree(r->slots);
+  Safefree(r);
+}
+
+/* The sink of rates(): only the counters are kept */
+void collect_rates(ppt_ctx* ctx, ppt_rec* rec){
+  ppt_rates* r = (ppt_rates*) ctx->data;
+  NV nv;
+  int i;
+
+  if( !r->resolved ){
+    r->f_pid = ppt_rec_field(rec, "pid");
+    r->f_start = ppt_rec_field(rec, "start");
+    for( i = 0; i < NRATE; i++ )
+      r->f_vals[i] = ppt_rec_field(rec, rate_fields[i]);
+    r->resolved = 1;
+  }
+  if( r->n == r->max ){
+    r->max = r->max ? r->max * 2 : 256;
+    Renew(r->pid, r->max, IV);
+    Renew(r->start, r->max, NV);
+    for( i = 0; i < NRATE; i++ )
+      Renew(r->vals[i], r->max, NV);
+  }
+
+  r->pid[r->n] = ppt_rec_pid(rec, r->f_pid);
+  if( r->f_start < 0 || !ppt_val_num(&rec->vals[r->f_start], &nv) )
+    nv = 0;
+  r->start[r->n] = nv;
+  for( i = 0; i < NRATE; i++ ){
+    if( r->f_vals[i] < 0 || !ppt_val_num(&rec->vals[r->f_vals[i]], &nv) )
+      nv = -1;
+    r->vals[i][r->n] = nv;
+  }
+  r->n++;
+  ppt_rec_free(rec);
+}
+
+static void rates_finish(ppt_rates* r){
+  int i, j;
+
+  for( r->nslots = 64; r->nslots < r->n * 2; r->nslots *= 2 )
+    ;
+  Newxz(r->slots, r->nslots, int);
+  for( i = 0; i < r->n; i++ ){
+    for( j = snap_pid_hash(r->pid[i]) & (r->nslots - 1); r->slots[j]; j = (j + 1) & (r->nslots - 1) )
+      ;
+    r->slots[j] = i + 1;
+  }
+}
+
+/* Index of the process with this pid and start time, -1 if none */
+static int rates_find(ppt_rates* r, IV pid, NV start){
+  int i, j;
+
+  for( j = snap_pid_hash(pid) & (r->nslots - 1); (i = r->slots[j]) != 0; j = (j + 1) & (r->nslots - 1) ){
+    if( r->pid[i - 1] == pid && r->start[i - 1] == start )
+      return i - 1;
+  }
+  return -1;
+}
+
+static NV monotonic_now(void){
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**********************************************************************/
+/* Background sampler                                                 */
+/* $t->start_sampler starts a thread that reads a packed snapshot     */
+/* every interval and publishes it; $t->latest only takes another     */
+/* reference to the last one published. The thread never touches     */
+/* perl: records and snapshots come from the C allocator, and         */
+/* bless_into_proc finds the thread's scan through Sampler_key.       */
+/* Publishing swaps a pointer under the sampler's mutex, which is     */
+/* never held during a scan. The snapshot that was replaced becomes   */
+/* the buffer for the next scan unless a Snapshot object still holds  */
+/* it, so in the steady state there are two buffers.                  */
+/*                                                                    */
+/* The thread doesn't survive fork(); in the child the sampler counts */
+/* as stopped and latest keeps returning the last snapshot.           */
+/*                                                                    */
+/* For $t->start_async the thread also bumps an eventfd after each    */
+/* scan, so an event loop can wait for it and call $t->harvest.       */
+/**********************************************************************/
+#ifdef PROCESSTABLE_SAMPLER
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/eventfd.h>
+
+/* What the sampler and the profiler (below) have in common */
+typedef struct ppt_thread {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;        /* signalled to stop the thread */
+  int running;                /* the thread runs in this process */
+  int stop;
+  int forked;                 /* this is a child of the process that started it */
+  struct ppt_thread* next;    /* in Threads */
+} ppt_thread;
+
+/* All threads, for the fork handlers */
+static pthread_mutex_t Threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static ppt_thread* Threads;
+static pthread_once_t Sampler_once = PTHREAD_ONCE_INIT;
+
+/* Nothing may hold a thread's lock across fork() */
+static void thread_atfork_prepare(void){
+  ppt_thread* t;
+
+  pthread_mutex_lock(&Threads_lock);
+  for( t = Threads; t != NULL; t = t->next )
+    pthread_mutex_lock(&t->lock);
+}
+
+static void thread_atfork_parent(void){
+  ppt_thread* t;
+
+  for( t = Threads; t != NULL; t = t->next )
+    pthread_mutex_unlock(&t->lock);
+  pthread_mutex_unlock(&Threads_lock);
+}
+
+static void thread_atfork_child(void){
+  ppt_thread* t;
+
+  for( t = Threads; t != NULL; t = t->next ){
+    t->running = 0;
+    t->forked = 1;
+    pthread_mutex_unlock(&t->lock);
+  }
+  pthread_mutex_unlock(&Threads_lock);
+}
+
+static void sampler_init(void){
+  pthread_key_create(&Sampler_key, NULL);
+  pthread_atfork(thread_atfork_prepare, thread_atfork_parent, thread_atfork_child);
+}
+
+static void timespec_add(struct timespec* ts, long nsec){
+  ts->tv_sec += nsec / 1000000000;
+  ts->tv_nsec += nsec % 1000000000;
+  if( ts->tv_nsec >= 1000000000 ){
+    ts->tv_sec++;
+    ts->tv_nsec -= 1000000000;
+  }
+}
+
+/* Sleep until the monotonic time until; false if the thread is to stop */
+static int thread_wait(ppt_thread* t, struct timespec* until){
+  int go;
+
+  pthread_mutex_lock(&t->lock);
+  while( !t->stop && pthread_cond_timedwait(&t->wake, &t->lock, until) != ETIMEDOUT )
+    ;
+  go = !t->stop;
+  pthread_mutex_unlock(&t->lock);
+  return go;
+}
+
+/* Start main on a thread; 0 or an errno value */
+static int thread_start(ppt_thread* t, void* (*main)(void*)){
+  pthread_condattr_t attr;
+  sigset_t all, old;
+  int rc;
+
+  pthread_once(&Sampler_once, sampler_init);
+
+  pthread_mutex_init(&t->lock, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&t->wake, &attr);
+  pthread_condattr_destroy(&attr);
+
+  pthread_mutex_lock(&Threads_lock);
+  t->next = Threads;
+  Threads = t;
+  t->running = 1;
+  /* signals are for perl's thread */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  rc = pthread_create(&t->thread, NULL, main, t);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if( rc != 0 ){
+    Threads = t->next;
+    t->running = 0;
+  }
+  pthread_mutex_unlock(&Threads_lock);
+
+  if( rc != 0 ){
+    pthread_cond_destroy(&t->wake);
+    pthread_mutex_destroy(&t->lock);
+  }
+  return rc;
+}
+
+/* Stop the thread and wait for it; the lock stays usable */
+static void thread_stop(ppt_thread* t){
+  ppt_thread** link;
+
+  pthread_mutex_lock(&Threads_lock);
+  for( link = &Threads; *link != NULL; link = &(*link)->next ){
+    if( *link == t ){
+      *link = t->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&Threads_lock);
+
+  if( t->running ){
+    pthread_mutex_lock(&t->lock);
+    t->stop = 1;
+    pthread_cond_signal(&t->wake);
+    pthread_mutex_unlock(&t->lock);
+    pthread_join(t->thread, NULL);
+    t->running = 0;
+  }
+}
+
+static void thread_free(ppt_thread* t){
+  thread_stop(t);
+  /* after a fork the condition may still count the lost thread as a
+     waiter, so it is left alone */
+  if( !t->forked )
+    pthread_cond_destroy(&t->wake);
+  pthread_mutex_destroy(&t->lock);
+}
+
+typedef struct ppt_sampler {
+  ppt_thread t;               /* first, the thread runs with a ppt_thread* */
+  long interval;              /* milliseconds between the starts of scans */
+  int notify;                 /* eventfd for start_async, -1 if none */
+  ppt_snap* latest;           /* NULL until the first scan is done */
+  UV scans;                   /* scans published */
+  UV harvested;               /* value of scans at the last harvest */
+} ppt_sampler;
+
+static void* sampler_main(void* arg){
+  ppt_sampler* s = (ppt_sampler*) arg;
+  ppt_ctx ctx;
+  ppt_snap* next = NULL;
+  ppt_snap* old;
+  struct timespec until;
+
+  pthread_setspecific(Sampler_key, &ctx);
+
+  do{
+    clock_gettime(CLOCK_MONOTONIC, &until);
+    timespec_add(&until, s->interval * 1000000);
+
+    if( next == NULL )
+      next = snap_new(1);
+    else
+      snap_reset(next);
+    Zero(&ctx, 1, ppt_ctx);
+    ctx.collect = collect_packed;
+    ctx.snap = next;
+    OS_get_table();
+    snap_finish(next);
+
+    pthread_mutex_lock(&s->t.lock);
+    old = s->latest;
+    s->latest = next;
+    s->scans++;
+    pthread_mutex_unlock(&s->t.lock);
+    if( s->notify >= 0 )
+      eventfd_write(s->notify, 1);
+
+    /* nobody can take a new reference to old any more, so if ours
+       was the last one it is the buffer for the next scan */
+    next = NULL;
+    if( old != NULL && snap_refcnt_dec(old) == 0 ){
+      old->refcnt = 1;
+      next = old;
+    }
+  } while( thread_wait(&s->t, &until) );
+
+  if( next != NULL )
+    snap_release(next);
+  return NULL;
+}
+
+/* NULL and errno set if the thread can't be started */
+static ppt_sampler* sampler_start(long interval, int notify){
+  ppt_sampler* s;
+  int rc;
+
+  PptNewz(s, 1, ppt_sampler);
+  s->interval = interval;
+  s->notify = -1;
+  if( notify && (s->notify = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0 ){
+    PptFree(s);
+    return NULL;
+  }
+
+  if( (rc = thread_start(&s->t, sampler_main)) != 0 ){
+    if( s->notify >= 0 )
+      close(s->notify);
+    PptFree(s);
+    errno = rc;
+    return NULL;
+  }
+  return s;
+}
+
+static void sampler_free(ppt_sampler* s){
+  thread_free(&s->t);
+  if( s->notify >= 0 )
+    close(s->notify);
+  if( s->latest != NULL )
+    snap_release(s->latest);
+  PptFree(s);
+}
+
+/* A new reference to the latest snapshot, or NULL; if fresh is set */
+/* only if it wasn't harvested before                                 */
+static ppt_snap* sampler_latest(ppt_sampler* s, int fresh){
+  ppt_snap* snap;
+  eventfd_t count;
+
+  /* reset the fd before looking, so a scan that finishes meanwhile
+     makes it readable again; a forked child must leave it alone */
+  if( fresh && s->notify >= 0 && s->t.running )
+    eventfd_read(s->notify, &count);
+
+  pthread_mutex_lock(&s->t.lock);
+  snap = s->latest;
+  if( fresh && s->scans == s->harvested )
+    snap = NULL;
+  if( snap != NULL ){
+    snap_refcnt_inc(snap);
+    s->harvested = s->scans;
+  }
+  pthread_mutex_unlock(&s->t.lock);
+  return snap;
+}
+#endif
+
+/**********************************************************************/
+/* Subtree profiler                                                   */
+/* $t->profile runs a thread that samples a process and its           */
+/* descendants at up to a few hundred Hz. Only their pids are read,   */
+/* with OS_get_proc and just the fields it needs. The set is taken    */
+/* from the kernel's lists of children on every tick where the OS     */
+/* code has them (OS_get_children), and from a ppid scan of the whole */
+/* table once a second otherwise. The samples go to a ring buffer     */
+/* that the perl side drains as TSV, in the format of                 */
+/* contrib/ppt_profile.pl; when the buffer is full the oldest samples */
+/* are overwritten.                                                   */
+/**********************************************************************/
+#if defined(PROCESSTABLE_SAMPLER) && defined(PROCESSTABLE_GET_PROC)
+#ifdef PROCESSTABLE_OS_CHILDREN
+int OS_get_children(long, long*, int);
+#endif
+
+typedef struct ppt_sample {
+  UV tick;
+  NV when;                    /* seconds since the profile started */
+  IV pid;
+  NV rss, size, time;
+} ppt_sample;
+
+typedef struct ppt_profile {
+  ppt_thread t;               /* first, the thread runs with a ppt_thread* */
+  long root;
+  long period;                /* nanoseconds between ticks */
+  NV t0;                      /* monotonic time of the start */
+  int done;                   /* the root process is gone */
+  ppt_sample* ring;           /* under t.lock from here */
+  UV size;
+  UV head;                    /* samples written, the next goes to ring[head % size] */
+  UV tail;                    /* samples drained */
+  UV dropped;                 /* samples overwritten before they were drained */
+  /* the thread's own */
+  long* pids;
+  int npids, maxpids;
+  ppt_sample* batch;          /* the samples of a tick */
+  int nbatch, maxbatch;
+  int f_pid, f_rss, f_size, f_time, resolved;
+  UV tick;
+  /* the drain's own */
+  IV* last_pids;              /* the previous tick, for the CPU rate */
+  NV* last_times;
+  int nlast, maxlast;
+  NV last_when;
+  int header;                 /* was the header written */
+} ppt_profile;
+
+static char* profile_fields[] = { "pid", "rss", "size", "time" };
+
+/* The sink of the samples */
+void collect_profile(ppt_ctx* ctx, ppt_rec* rec){
+  ppt_profile* p = (ppt_profile*) ctx->data;
+  ppt_sample* sample;
+  NV nv;
+
+  if( !p->resolved ){
+    p->f_pid = ppt_rec_field(rec, "pid");
+    p->f_rss = ppt_rec_field(rec, "rss");
+    p->f_size = ppt_rec_field(rec, "size");
+    p->f_time = ppt_rec_field(rec, "time");
+    p->resolved = 1;
+  }
+  if( p->nbatch == p->maxbatch ){
+    p->maxbatch = p->maxbatch ? p->maxbatch * 2 : 64;
+    PptRenew(p->batch, p->maxbatch, ppt_sample);
+  }
+  sample = &p->batch[p->nbatch++];
+  sample->pid = ppt_rec_pid(rec, p->f_pid);
+  sample->rss = p->f_rss >= 0 && ppt_val_num(&rec->vals[p->f_rss], &nv) ? nv : 0;
+  sample->size = p->f_size >= 0 && ppt_val_num(&rec->vals[p->f_size], &nv) ? nv : 0;
+  sample->time = p->f_time >= 0 && ppt_val_num(&rec->vals[p->f_time], &nv) ? nv : 0;
+  ppt_rec_free(rec);
+}
+
+/* The sink of the ppid scans: the snapshot keeps the tree */
+static void profile_room(ppt_profile* p, int n){
+  if( p->npids + n > p->maxpids ){
+    p->maxpids = (p->npids + n) * 2;
+    PptRenew(p->pids, p->maxpids, long);
+  }
+}
+
+#ifdef PROCESSTABLE_OS_CHILDREN
+/* The subtree from the lists of children; false if there are none */
+static int profile_children(ppt_profile* p){
+  int i, n;
+
+  p->npids = 0;
+  profile_room(p, 16);
+  p->pids[p->npids++] = p->root;
+  for( i = 0; i < p->npids; i++ ){
+    while( (n = OS_get_children(p->pids[i], p->pids + p->npids, p->maxpids - p->npids)) > p->maxpids - p->npids )
+      profile_room(p, n);
+    if( n < 0 )
+      return 0;
+    p->npids += n;
+    profile_room(p, 16);
+  }
+  return 1;
+}
+#endif
+
+/* The subtree from the ppids of the whole table */
+static void profile_scan(ppt_profile* p, ppt_ctx* ctx, ppt_snap** tree){
+  int* order;
+  int i, k, n;
+
+  if( *tree == NULL )
+    *tree = snap_new(0);
+  else
+    snap_reset(*tree);
+  Zero(ctx, 1, ppt_ctx);
+  ctx->collect = collect_tree;
+  ctx->snap = *tree;
+  OS_get_table();
+  snap_finish(*tree);
+
+  p->npids = 0;
+  if( (i = snap_find(*tree, p->root)) < 0 ){
+    profile_room(p, 1);
+    p->pids[p->npids++] = p->root;
+    return;
+  }
+  PptNew(order, (*tree)->n, int);
+  n = snap_subtree(*tree, i, order);
+  profile_room(p, n);
+  for( k = 0; k < n; k++ )
+    p->pids[p->npids++] = (*tree)->pid[order[k]];
+  PptFree(order);
+}
+
+static void* profile_main(void* arg){
+  ppt_profile* p = (ppt_profile*) arg;
+  ppt_ctx ctx;
+  ppt_snap* tree = NULL;
+  struct timespec until, now;
+  NV when, rescan = 0;
+  int i, have_root;
+  int use_children = 0;
+
+#ifdef PROCESSTABLE_OS_CHILDREN
+  use_children = 1;
+#endif
+  pthread_setspecific(Sampler_key, &ctx);
+  clock_gettime(CLOCK_MONOTONIC, &until);
+
+  do{
+    when = monotonic_now() - p->t0;
+
+#ifdef PROCESSTABLE_OS_CHILDREN
+    if( use_children && !profile_children(p) )
+      use_children = 0;
+#endif
+    if( !use_children && (tree == NULL || when >= rescan) ){
+      profile_scan(p, &ctx, &tree);
+      rescan = when + 1;
+    }
+
+    Zero(&ctx, 1, ppt_ctx);
+    ctx.collect = collect_profile;
+    ctx.data = p;
+    p->nbatch = 0;
+    have_root = 0;
+    for( i = 0; i < p->npids; i++ ){
+      if( OS_get_proc(p->pids[i], profile_fields, 4) && p->pids[i] == p->root )
+        have_root = 1;
+    }
+
+    pthread_mutex_lock(&p->t.lock);
+    for( i = 0; i < p->nbatch; i++ ){
+      p->batch[i].tick = p->tick;
+      p->batch[i].when = when;
+      p->ring[p->head++ % p->size] = p->batch[i];
+    }
+    if( !have_root )
+      p->done = 1;
+    pthread_mutex_unlock(&p->t.lock);
+    p->tick++;
+
+    /* don't try to catch up with ticks that were missed */
+    timespec_add(&until, p->period);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if( until.tv_sec < now.tv_sec || (until.tv_sec == now.tv_sec && until.tv_nsec < now.tv_nsec) )
+      until = now;
+  } while( have_root && thread_wait(&p->t, &until) );
+
+  if( tree != NULL )
+    snap_release(tree);
+  PptFree(p->pids);
+  PptFree(p->batch);
+  p->pids = NULL;
+  p->batch = NULL;
+  return NULL;
+}
+
+/* NULL and errno set if the thread can't be started */
+static ppt_profile* profile_start(long root, int hz, UV size){
+  ppt_profile* p;
+  int rc;
+
+  PptNewz(p, 1, ppt_profile);
+  p->root = root;
+  p->period = 1000000000 / hz;
+  p->size = size;
+  PptNew(p->ring, size, ppt_sample);
+  p->t0 = monotonic_now();
+
+  if( (rc = thread_start(&p->t, profile_main)) != 0 ){
+    PptFree(p->ring);
+    PptFree(p);
+    errno = rc;
+    return NULL;
+  }
+  return p;
+}
+
+static void profile_free(ppt_profile* p){
+  thread_free(&p->t);
+  PptFree(p->ring);
+  PptFree(p->pids);
+  PptFree(p->batch);
+  PptFree(p->last_pids);
+  PptFree(p->last_times);
+  PptFree(p);
+}
+
+/* CPU time of pid in the previous tick, -1 if it wasn't there; hint */
+/* is where it would be if the set didn't change                      */
+static NV profile_last_time(ppt_profile* p, IV pid, int hint){
+  int i;
+
+  if( hint < p->nlast && p->last_pids[hint] == pid )
+    return p->last_times[hint];
+  for( i = 0; i < p->nlast; i++ ){
+    if( p->last_pids[i] == pid )
+      return p->last_times[i];
+  }
+  return -1;
+}
+
+/* Append the TSV lines of the samples of one tick to out */
+static void profile_tick_tsv(pTHX_ ppt_profile* p, ppt_sample* samples, int n, SV* out){
+  NV rss = 0, size = 0, cpu = 0, last;
+  int i;
+
+  sv_catpvf(out, "%" UVuf "\t%.3f\t", samples[0].tick + 1, samples[0].when);
+  for( i = 0; i < n; i++ ){
+    sv_catpvf(out, i ? ",%" IVdf : "%" IVdf, samples[i].pid);
+    rss += samples[i].rss;
+    size += samples[i].size;
+    if( (last = profile_last_time(p, samples[i].pid, i)) >= 0 && samples[i].time > last )
+      cpu += samples[i].time - last;
+  }
+  /* CPU used since the previous tick as a fraction of one CPU, only
+     counting processes that were there in both */
+  cpu = p->nlast && samples[0].when > p->last_when
+    ? cpu / 1e6 / (samples[0].when - p->last_when) : 0;
+  sv_catpvf(out, "\t%.0f\t%.0f\t%g\n", rss, size, cpu);
+
+  if( n > p->maxlast ){
+    p->maxlast = n * 2;
+    PptRenew(p->last_pids, p->maxlast, IV);
+    PptRenew(p->last_times, p->maxlast, NV);
+  }
+  for( i = 0; i < n; i++ ){
+    p->last_pids[i] = samples[i].pid;
+    p->last_times[i] = samples[i].time;
+  }
+  p->nlast = n;
+  p->last_when = samples[0].when;
+}
+#endif
+
+/**********************************************************************/
+/* Process events                                                     */
+/* $t->events subscribes to the kernel's proc connector, a netlink    */
+/* socket that tells about every fork, exec and exit; this needs the  */
+/* privileges the connector asks for (CAP_NET_ADMIN on most kernels). */
+/* The socket is non-blocking, so an event loop can watch it and call */
+/* read. With live => 1 the object also keeps a table of process      */
+/* objects that it updates from the events, reading only the pids    */
+/* that forked or exec'd; if the kernel drops events it reads the     */
+/* whole table again.                                                 */
+/**********************************************************************/
+#ifdef PROCESSTABLE_PROC_EVENTS
+#include <errno.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+typedef struct ppt_events {
+  int fd;
+  HV* procs;                  /* pid => object for live tables, NULL otherwise */
+  UV lost;                    /* times the kernel dropped events */
+  pid_t owner;                /* the process that subscribed */
+} ppt_events;
+
+/* Tell the connector to start or stop sending; -1 and errno if it */
+/* can't be done                                                      */
+static int events_listen(int fd, enum proc_cn_mcast_op op){
+  struct {
+    struct nlmsghdr nl;
+    struct cn_msg cn;
+    enum proc_cn_mcast_op op;
+  } __attribute__((packed)) msg;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.nl.nlmsg_len = sizeof(msg);
+  msg.nl.nlmsg_type = NLMSG_DONE;
+  msg.cn.id.idx = CN_IDX_PROC;
+  msg.cn.id.val = CN_VAL_PROC;
+  msg.cn.len = sizeof(msg.op);
+  msg.op = op;
+  return send(fd, &msg, sizeof(msg), 0) < 0 ? -1 : 0;
+}
+
+/* The subscribed socket, or -1 and errno */
+static int events_open(void){
+  struct sockaddr_nl addr;
+  int fd, err;
+
+  if( (fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR)) < 0 )
+    return -1;
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = CN_IDX_PROC;
+  if( bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+      events_listen(fd, PROC_CN_MCAST_LISTEN) < 0 ){
+    err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+  }
+  return fd;
+}
+
+static void events_free(ppt_events* ev){
+  dTHX;
+
+  /* the kernel only counts listeners, so a forked child sharing the
+     socket must not unsubscribe */
+  if( getpid() == ev->owner )
+    events_listen(ev->fd, PROC_CN_MCAST_IGNORE);
+  close(ev->fd);
+  if( ev->procs != NULL )
+    SvREFCNT_dec((SV*) ev->procs);
+  Safefree(ev);
+}
+
+/* The sink of live tables: the objects go into the hash by pid */
+void collect_live(ppt_ctx* ctx, ppt_rec* rec){
+  dTHX;
+  char key[32];
+  IV pid;
+  int f;
+
+  f = ppt_rec_field(rec, "pid");
+  if( (pid = ppt_rec_pid(rec, f)) >= 0 ){
+    my_snprintf(key, sizeof(key), "%" IVdf, pid);
+    hv_store((HV*) ctx->data, key, strlen(key), ppt_rec_bless(ctx->ttydevs, rec), 0);
+  }
+  ppt_rec_free(rec);
+}
+
+/* Read one process, or all of them for pid -1, into the live table */
+static void events_read_proc(ppt_events* ev, IV pid){
+  ppt_ctx ctx;
+
+  if( pid < 0 )
+    hv_clear(ev->procs);
+  Zero(&ctx, 1, ppt_ctx);
+  ctx.collect = collect_live;
+  ctx.data = ev->procs;
+  ppt_scan(&ctx, (long) pid, NULL, 0);
+}
+
+/* A hash for one event, NULL for the ones that aren't reported; the */
+/* live table is updated on the way                                   */
+static HV* events_event(ppt_events* ev, struct proc_event* pe){
+  dTHX;
+  HV* hash;
+  IV pid, tid;
+  char key[32];
+
+  switch(pe->what)
+    {
+    case PROC_EVENT_FORK:
+      pid = pe->event_data.fork.child_tgid;
+      tid = pe->event_data.fork.child_pid;
+      hash = newHV();
+      hv_stores(hash, "what", newSVpvs("fork"));
+      hv_stores(hash, "ppid", newSViv(pe->event_data.fork.parent_tgid));
+      break;
+    case PROC_EVENT_EXEC:
+      pid = pe->event_data.exec.process_tgid;
+      tid = pe->event_data.exec.process_pid;
+      hash = newHV();
+      hv_stores(hash, "what", newSVpvs("exec"));
+      break;
+    case PROC_EVENT_EXIT:
+      pid = pe->event_data.exit.process_tgid;
+      tid = pe->event_data.exit.process_pid;
+      hash = newHV();
+      hv_stores(hash, "what", newSVpvs("exit"));
+      hv_stores(hash, "exit_code", newSViv(pe->event_data.exit.exit_code));
+      hv_stores(hash, "exit_signal", newSViv(pe->event_data.exit.exit_signal));
+      break;
+    default:
+      return NULL;
+    }
+  hv_stores(hash, "pid", newSViv(pid));
+  hv_stores(hash, "tid", newSViv(tid));
+  hv_stores(hash, "cpu", newSVuv(pe->cpu));
+  hv_stores(hash, "time", newSVnv(pe->timestamp_ns / 1e9));
+
+  /* threads come and go without changing the table */
+  if( ev->procs != NULL && pid == tid ){
+    if( pe->what == PROC_EVENT_EXIT ){
+      my_snprintf(key, sizeof(key), "%" IVdf, pid);
+      hv_delete(ev->procs, key, strlen(key), G_DISCARD);
+    }
+    else
+      events_read_proc(ev, pid);
+  }
+  return hash;
+}
+#endif
+
+/**********************************************************************/
+/* Exit accounting                                                    */
+/* $t->exits registers with the kernel's taskstats interface for the  */
+/* exits on all CPUs, so it sees the final counters of tasks that     */
+/* live too short for any scan. read either returns a record per      */
+/* exit, or with by => uid or fname only adds them to totals kept in  */
+/* C, one ppt_exit_totals per key, which totals turns into hashes.    */
+/**********************************************************************/
+#ifdef PROCESSTABLE_TASKSTATS
+#include <errno.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+#include <linux/taskstats.h>
+
+#define NEXIT 12
+
+/* The counters that are summed, as they are in the records */
+static const char* const exit_sums[NEXIT] =
+{
+    "utime",
+    "stime",
+    "time",
+    "minflt",
+    "majflt",
+    "rchar",
+    "wchar",
+    "read_bytes",
+    "write_bytes",
+    "cpu_delay",
+    "blkio_delay",
+    "swapin_delay"
+};
+
+typedef struct {
+  UV count;
+  NV sums[NEXIT];
+  NV maxrss;
+} ppt_exit_totals;
+
+typedef struct ppt_exits {
+  int fd;
+  int family;                 /* of TASKSTATS */
+  char cpumask[32];           /* what was registered */
+  int by;                     /* 0 for records, 'u' by uid, 'f' by fname */
+  pid_t owner;                /* the process that registered */
+  HV* totals;                 /* key => ppt_exit_totals in a PV */
+  UV lost;                    /* times the kernel dropped exits */
+} ppt_exits;
+
+/* An attribute of a generic netlink message */
+#define EXIT_ATTR_DATA(na)  ((void*) ((char*) (na) + NLA_HDRLEN))
+#define EXIT_ATTR_NEXT(na)  ((struct nlattr*) ((char*) (na) + NLA_ALIGN((na)->nla_len)))
+
+/* Send a generic netlink request with one string or u16 attribute */
+static int exits_request(int fd, int type, int cmd, int attr, const void* data, int len){
+  struct {
+    struct nlmsghdr nl;
+    struct genlmsghdr genl;
+    char buf[64];
+  } msg;
+  struct nlattr* na;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.nl.nlmsg_type = type;
+  msg.nl.nlmsg_flags = NLM_F_REQUEST;
+  msg.nl.nlmsg_pid = 0;
+  msg.genl.cmd = cmd;
+  msg.genl.version = 1;
+  na = (struct nlattr*) msg.buf;
+  na->nla_type = attr;
+  na->nla_len = NLA_HDRLEN + len;
+  memcpy(EXIT_ATTR_DATA(na), data, len);
+  msg.nl.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN) + NLA_ALIGN(na->nla_len);
+  return send(fd, &msg, msg.nl.nlmsg_len, 0) < 0 ? -1 : 0;
+}
+
+/* The family id of TASKSTATS, or -1 and errno */
+static int exits_family(int fd){
+  union {
+    struct nlmsghdr nl;
+    char buf[1024];
+  } msg;
+  struct nlmsghdr* nl = &msg.nl;
+  struct nlattr* na;
+  ssize_t len;
+  int rest;
+
+  if( exits_request(fd, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, CTRL_ATTR_FAMILY_NAME,
+                    TASKSTATS_GENL_NAME, sizeof(TASKSTATS_GENL_NAME)) < 0 )
+    return -1;
+  while( (len = recv(fd, &msg, sizeof(msg), 0)) < 0 && errno == EINTR )
+    ;
+  if( len < 0 )
+    return -1;
+  if( !NLMSG_OK(nl, len) || nl->nlmsg_type == NLMSG_ERROR ){
+    errno = nl->nlmsg_type == NLMSG_ERROR ? -((struct nlmsgerr*) NLMSG_DATA(nl))->error : EPROTO;
+    return -1;
+  }
+  na = (struct nlattr*) ((char*) NLMSG_DATA(nl) + GENL_HDRLEN);
+  for( rest = nl->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN); rest >= NLA_HDRLEN; rest -= NLA_ALIGN(na->nla_len), na = EXIT_ATTR_NEXT(na) ){
+    if( na->nla_type == CTRL_ATTR_FAMILY_ID )
+      return *(__u16*) EXIT_ATTR_DATA(na);
+  }
+  errno = ENOENT;
+  return -1;
+}
+
+/* The registered socket, or NULL and errno */
+static ppt_exits* exits_open(int by){
+  ppt_exits* ex;
+  struct sockaddr_nl addr;
+  int err;
+
+  Newxz(ex, 1, ppt_exits);
+  ex->by = by;
+  ex->owner = getpid();
+  if( (ex->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC)) < 0 ){
+    Safefree(ex);
+    return NULL;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  my_snprintf(ex->cpumask, sizeof(ex->cpumask), "0-%ld", sysconf(_SC_NPROCESSORS_CONF) - 1);
+  if( bind(ex->fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+      (ex->family = exits_family(ex->fd)) < 0 ||
+      exits_request(ex->fd, ex->family, TASKSTATS_CMD_GET, TASKSTATS_CMD_ATTR_REGISTER_CPUMASK,
+                    ex->cpumask, strlen(ex->cpumask) + 1) < 0 ){
+    err = errno;
+    close(ex->fd);
+    Safefree(ex);
+    errno = err;
+    return NULL;
+  }
+  /* only now, the family lookup waits for its answer */
+  fcntl(ex->fd, F_SETFL, fcntl(ex->fd, F_GETFL) | O_NONBLOCK);
+  if( by ){
+    dTHX;
+    ex->totals = newHV();
+  }
+  return ex;
+}
+
+static void exits_free(ppt_exits* ex){
+  dTHX;
+
+  /* the registration is by socket, which a forked child shares */
+  if( getpid() == ex->owner )
+    exits_request(ex->fd, ex->family, TASKSTATS_CMD_GET, TASKSTATS_CMD_ATTR_DEREGISTER_CPUMASK,
+                ex->cpumask, strlen(ex->cpumask) + 1);
+  close(ex->fd);
+  if( ex->totals != NULL )
+    SvREFCNT_dec((SV*) ex->totals);
+  Safefree(ex);
+}
+
+/* The counters of exit_sums, in the units of the process fields: */
+/* microseconds and bytes                                             */
+static void exits_sums(struct taskstats* ts, NV* sums){
+  sums[0] = ts->ac_utime;
+  sums[1] = ts->ac_stime;
+  sums[2] = (NV) ts->ac_utime + ts->ac_stime;
+  sums[3] = ts->ac_minflt;
+  sums[4] = ts->ac_majflt;
+  sums[5] = ts->read_char;
+  sums[6] = ts->write_char;
+  sums[7] = ts->read_bytes;
+  sums[8] = ts->write_bytes;
+  sums[9] = ts->cpu_delay_total / 1e3;
+  sums[10] = ts->blkio_delay_total / 1e3;
+  sums[11] = ts->swapin_delay_total / 1e3;
+}
+
+/* The record of one exit */
+static HV* exits_record(struct taskstats* ts){
+  dTHX;
+  HV* hash = newHV();
+  NV sums[NEXIT];
+  int i;
+
+  hv_stores(hash, "pid", newSVuv(ts->ac_pid));
+  hv_stores(hash, "ppid", newSVuv(ts->ac_ppid));
+  hv_stores(hash, "uid", newSVuv(ts->ac_uid));
+  hv_stores(hash, "gid", newSVuv(ts->ac_gid));
+  hv_stores(hash, "fname", newSVpvn(ts->ac_comm, strnlen(ts->ac_comm, sizeof(ts->ac_comm))));
+  hv_stores(hash, "start", newSVuv(ts->ac_btime));
+  hv_stores(hash, "elapsed", newSVnv(ts->ac_etime));
+  hv_stores(hash, "exit_code", newSVuv(ts->ac_exitcode));
+  hv_stores(hash, "maxrss", newSVnv(ts->hiwater_rss * 1024.0));
+  hv_stores(hash, "maxsize", newSVnv(ts->hiwater_vm * 1024.0));
+  exits_sums(ts, sums);
+  for( i = 0; i < NEXIT; i++ )
+    hv_store(hash, exit_sums[i], strlen(exit_sums[i]), newSVnv(sums[i]), 0);
+  return hash;
+}
+
+/* Add one exit to the totals of its key */
+static void exits_add(ppt_exits* ex, struct taskstats* ts){
+  dTHX;
+  ppt_exit_totals* t;
+  SV** fetched;
+  char key[TS_COMM_LEN + 1];
+  NV sums[NEXIT];
+  int len, i;
+
+  if( ex->by == 'u' )
+    len = my_snprintf(key, sizeof(key), "%lu", (unsigned long) ts->ac_uid);
+  else{
+    len = strnlen(ts->ac_comm, sizeof(ts->ac_comm));
+    memcpy(key, ts->ac_comm, len);
+  }
+  fetched = hv_fetch(ex->totals, key, len, 1);
+  if( !SvPOK(*fetched) ){
+    sv_setpvn(*fetched, "", 0);
+    t = (ppt_exit_totals*) SvGROW(*fetched, sizeof(ppt_exit_totals));
+    Zero(t, 1, ppt_exit_totals);
+  }
+  t = (ppt_exit_totals*) SvPVX(*fetched);
+  exits_sums(ts, sums);
+  t->count++;
+  for( i = 0; i < NEXIT; i++ )
+    t->sums[i] += sums[i];
+  if( ts->hiwater_rss * 1024.0 > t->maxrss )
+    t->maxrss = ts->hiwater_rss * 1024.0;
+}
+#endif
+
+/**********************************************************************/
+/* Waiting for processes to exit                                      */
+/* $t->wait_exit opens a pidfd for each pid and sleeps in epoll until */
+/* they become readable, which they do when the process exits. Pids   */
+/* that pidfd_open can't be used for (kernels before 5.3) are checked */
+/* with kill(pid, 0) every poll milliseconds instead.                 */
+/**********************************************************************/
+#ifdef PROCESSTABLE_PIDFD
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+
+static int ppt_pidfd_open(pid_t pid){
+#ifdef SYS_pidfd_open
+  return syscall(SYS_pidfd_open, pid, 0);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+/* Is the process still there, for kernels without pidfds */
+static int pid_alive(pid_t pid){
+  return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+/* Wait until one of the processes exited, or all of them if all is */
+/* set, or timeout milliseconds passed (forever if it is negative).   */
+/* gone[i] is set for the ones that exited; returns how many did.     */
+static int pids_wait(pTHX_ pid_t* pids, char* gone, int n, int all, long timeout, long poll){
+  struct epoll_event ev, ready[64];
+  int* fds;
+  int epfd, ngone = 0, npolled = 0, nready, wait, i;
+  NV deadline = 0, left;
+
+  Newx(fds, n ? n : 1, int);
+  epfd = epoll_create1(EPOLL_CLOEXEC);
+  for( i = 0; i < n; i++ ){
+    gone[i] = 0;
+    fds[i] = epfd < 0 ? -1 : ppt_pidfd_open(pids[i]);
+    if( fds[i] < 0 && errno == ESRCH ){
+      gone[i] = 1;
+      ngone++;
+      continue;
+    }
+    if( fds[i] >= 0 ){
+      ev.events = EPOLLIN;
+      ev.data.u32 = i;
+      if( epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev) == 0 )
+        continue;
+      close(fds[i]);
+      fds[i] = -1;
+    }
+    npolled++;
+  }
+
+  if( timeout >= 0 )
+    deadline = monotonic_now() + timeout / 1e3;
+  while( all ? ngone < n : ngone == 0 ){
+    wait = -1;
+    if( timeout >= 0 ){
+      if( (left = deadline - monotonic_now()) <= 0 )
+        break;
+      wait = (int) (left * 1e3) + 1;
+    }
+    if( npolled && (wait < 0 || wait > poll) )
+      wait = poll;
+
+    nready = epfd >= 0 ? epoll_wait(epfd, ready, 64, wait) : (usleep(wait * 1000), 0);
+    if( nready < 0 ){
+      if( errno != EINTR )
+        break;
+      /* let perl's signal handlers run */
+      PERL_ASYNC_CHECK();
+      continue;
+    }
+    for( i = 0; i < nready; i++ ){
+      int j = ready[i].data.u32;
+
+      epoll_ctl(epfd, EPOLL_CTL_DEL, fds[j], NULL);
+      gone[j] = 1;
+      ngone++;
+    }
+    for( i = 0; npolled && i < n; i++ ){
+      if( fds[i] < 0 && !gone[i] && !pid_alive(pids[i]) ){
+        gone[i] = 1;
+        ngone++;
+        npolled--;
+      }
+    }
+  }
+
+  for( i = 0; i < n; i++ ){
+    if( fds[i] >= 0 )
+      close(fds[i]);
+  }
+  if( epfd >= 0 )
+    close(epfd);
+  Safefree(fds);
+  return ngone;
+}
+#endif
+
+/**********************************************************************/
+/* table(refresh => 1)                                                */
+/* Processes that were already in the previous table, with the same  */
+/* pid and start time, keep their Proc::ProcessTable::Process object; */
+/* its values are overwritten in place, mostly without allocating.    */
+/* Only new processes get new objects, and the objects of processes   */
+/* that exited are dropped from the table.                            */
+/**********************************************************************/
+
+/* The previous table */
+typedef struct {
+  ppt_snap* snap;
+  SV** objs;                  /* indexed like snap, NULL once taken over */
+  int n;
+} ppt_prev;
+
+/* Store a record value into an existing SV of the hash; false if it */
+/* can't be done in place and the SV needs to be replaced             */
+static int ppt_val_update(SV* sv, ppt_val* val, int interned){
+  dTHX;
+  const char* buf;
+  STRLEN len;
+
+  if( sv == &PL_sv_undef )
+    return val->fmt == 'A';
+  if( val->fmt == 'a' )
+    return lazy_array_raw(sv, &buf, &len) &&
+      len == val->u.str.len && memEQ(buf, val->u.str.pv, len);
+  if( SvREADONLY(sv) || SvROK(sv) || SvMAGICAL(sv) )
+    return 0;
+
+  switch(val->fmt)
+    {
+    case 's':
+      if( SvPOK(sv) && SvCUR(sv) == val->u.str.len &&
+          memEQ(SvPVX(sv), val->u.str.pv, val->u.str.len) )
+        return 1;
+      if( interned )
+        return 0;
+      sv_setpvn(sv, val->u.str.pv, val->u.str.len);
+      return 1;
+    case 'i':
+      sv_setiv(sv, val->u.iv);
+      return 1;
+    case 'u':
+      sv_setuv(sv, val->u.uv);
+      return 1;
+    case 'l':
+    case 'j':
+      sv_setnv(sv, val->u.iv);
+      return 1;
+    case 'p':
+      sv_setnv(sv, val->u.uv);
+      return 1;
+    case 'A':
+    case 'V':
+      return 0;
+    }
+  sv_setsv(sv, &PL_sv_undef);
+  return 1;
+}
+
+/* Overwrite the values of a process object with those of a record; */
+/* only the fields flagged in want, unless that's NULL                */
+static void ppt_rec_update(HV* ttydevs, HV* myhash, ppt_rec* rec, int rolled,
+                           const char* want){
+  dTHX;
+  char* key;
+  ppt_val* val;
+  SV** svp;
+  char treekey[32];
+  int interned, tty_same, i;
+
+  for( i = 0; i < rec->nvals; i++ ){
+    if( want != NULL && !want[i] )
+      continue;
+    key = rec->fields[i];
+    val = &rec->vals[i];
+    interned = val->fmt == 's' && Intern != NULL && Intern[i] && rec->fields == Fields;
+    svp = hv_fetch(myhash, key, strlen(key), 0);
+
+    tty_same = 1;
+    if( (val->fmt == 'i' || val->fmt == 'l') && !strcmp(key, "ttynum") )
+      tty_same = svp && SvIOK(*svp) && SvIVX(*svp) == val->u.iv;
+
+    if( svp == NULL || !ppt_val_update(*svp, val, interned) ){
+      if( interned )
+        hv_store(myhash, key, strlen(key),
+                 intern_sv(val->u.str.pv, val->u.str.len, Intern[i] == 2), 0);
+      else
+        hv_store(myhash, key, strlen(key), ppt_val_sv(val), 0);
+    }
+    if( !tty_same )
+      store_ttydev( ttydevs, myhash, val->u.iv );
+  }
+
+  /* the totals of the last rollup() are out of date now */
+  if( rolled && hv_exists(myhash, "tree_count", 10) ){
+    hv_delete(myhash, "tree_count", 10, G_DISCARD);
+    for( i = 0; i < NROLL; i++ ){
+      my_snprintf(treekey, sizeof(treekey), "tree_%s", roll_fields[i]);
+      hv_delete(myhash, treekey, strlen(treekey), G_DISCARD);
+    }
+  }
+}
+
+void collect_refresh(ppt_ctx* ctx, ppt_rec* rec){
+  dTHX;
+  ppt_prev* prev = (ppt_prev*) ctx->data;
+  ppt_snap* snap = ctx->snap;
+  SV* obj = NULL;
+  SV** fetched;
+  IV pid;
+  int i;
+
+  snap_add(snap, rec);
+  pid = snap->pid[snap->n - 1];
+
+  /* the pid check guards against callers that modified the array */
+  if( (i = snap_find(prev->snap, pid)) >= 0 && i < prev->n &&
+      prev->snap->start[i] == snap->start[snap->n - 1] &&
+      (obj = prev->objs[i]) != NULL &&
+      SvROK(obj) && SvTYPE(SvRV(obj)) == SVt_PVHV &&
+      (fetched = hv_fetch((HV*) SvRV(obj), "pid", 3, 0)) != NULL &&
+      SvIV(*fetched) == pid ){
+    prev->objs[i] = NULL;
+    ppt_rec_update(ctx->ttydevs, (HV*) SvRV(obj), rec, prev->snap->rolled, NULL);
+  }
+  else
+    obj = ppt_rec_bless(ctx->ttydevs, rec);
+
+  av_push(ctx->proclist, obj);
+  ppt_rec_free(rec);
+}
+
+/**********************************************************************/
+/* $p->refresh                                                        */
+/* Reads one process again and updates its object in place. OS code   */
+/* that defines OS_get_proc() reads just that process; elsewhere the  */
+/* whole table is read and only the record of the pid is kept.       */
+/**********************************************************************/
+typedef struct {
+  IV pid;
+  ppt_rec* rec;
+} ppt_one;
+
+void collect_one(ppt_ctx* ctx, ppt_rec* rec){
+  ppt_one* one = (ppt_one*) ctx->data;
+
+  if( one->rec == NULL && ppt_rec_pid(rec, ppt_rec_field(rec, "pid")) == one->pid )
+    one->rec = rec;
+  else
+    ppt_rec_free(rec);
+}
+
+/* Read the record of pid; NULL if there is no such process */
+static ppt_rec* ppt_rec_read(ppt_ctx* ctx, IV pid, char** names, int nnames){
+  ppt_one one;
+
+  one.pid = pid;
+  one.rec = NULL;
+  Zero(ctx, 1, ppt_ctx);
+  ctx->collect = collect_one;
+  ctx->data = &one;
+  ppt_scan(ctx, pid, names, nnames);
+  return one.rec;
+}
+
+/**********************************************************************/
+/* Process handles                                                    */
+/* $p->handle and table(pidfds => 1) open a pidfd for a process and   */
+/* check that the pid still has the start time of the object, so the */
+/* handle is known to refer to that process. Signals sent through it  */
+/* can't reach another process that got the pid later.                */
+/**********************************************************************/
+#ifdef PROCESSTABLE_PIDFD
+#include <poll.h>
+
+typedef struct ppt_handle {
+  int fd;
+  IV pid;
+} ppt_handle;
+
+/* A handle on pid, if it still is the process that started at start */
+/* (unless that is NULL); NULL with errno set otherwise               */
+static ppt_handle* handle_open(IV pid, NV* start){
+  ppt_handle* h;
+  ppt_ctx ctx;
+  ppt_rec* rec;
+  char* names[] = { "start" };
+  NV nv;
+  int fd, f, same = 1;
+
+  if( (fd = ppt_pidfd_open(pid)) < 0 )
+    return NULL;
+
+  /* the pidfd refers to whoever has the pid now */
+  if( start != NULL ){
+    rec = ppt_rec_read(&ctx, pid, names, 1);
+    same = rec != NULL && (f = ppt_rec_field(rec, "start")) >= 0 &&
+      ppt_val_num(&rec->vals[f], &nv) && nv == *start;
+    if( rec != NULL )
+      ppt_rec_free(rec);
+  }
+  if( !same ){
+    close(fd);
+    errno = ESRCH;
+    return NULL;
+  }
+
+  PptNew(h, 1, ppt_handle);
+  h->fd = fd;
+  h->pid = pid;
+  return h;
+}
+
+/* Has the process not exited yet */
+static int handle_alive(ppt_handle* h){
+  struct pollfd pfd;
+
+  pfd.fd = h->fd;
+  pfd.events = POLLIN;
+  return poll(&pfd, 1, 0) == 0;
+}
+
+static int handle_signal(ppt_handle* h, int sig){
+#ifdef SYS_pidfd_send_signal
+  return syscall(SYS_pidfd_send_signal, h->fd, sig, NULL, 0);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+static void handle_free(ppt_handle* h){
+  close(h->fd);
+  PptFree(h);
+}
+
+/* The handle of a process object, opened and stored on it the first  */
+/* time; undef if the process is gone                                 */
+static SV* process_handle(HV* hash){
+  dTHX;
+  ppt_handle* h;
+  SV** fetched;
+  SV** start;
+  NV nv;
+  SV* sv;
+
+  if( (fetched = hv_fetch(hash, "Handle", 6, 0)) != NULL &&
+      sv_isa(*fetched, "Proc::ProcessTable::Handle") )
+    return *fetched;
+  if( (fetched = hv_fetch(hash, "pid", 3, 0)) == NULL || !SvOK(*fetched) )
+    return &PL_sv_undef;
+
+  start = hv_fetch(hash, "start", 5, 0);
+  if( start != NULL && SvOK(*start) )
+    nv = SvNV(*start);
+  if( (h = handle_open(SvIV(*fetched), start != NULL && SvOK(*start) ? &nv : NULL)) == NULL )
+    return &PL_sv_undef;
+  sv = sv_setref_pv(newSV(0), "Proc::ProcessTable::Handle", h);
+  hv_store(hash, "Handle", 6, sv, 0);
+  return sv;
+}
+
+#define PPT_PIDFDS 1
+#else
+#define PPT_PIDFDS 0
+#endif
+
+/* table(pidfds => 1); objects kept by refresh already have theirs */
+static void table_handles(AV* proclist){
+#ifdef PROCESSTABLE_PIDFD
+  dTHX;
+  int i;
+
+  for( i = 0; i <= av_len(proclist); i++ )
+    process_handle((HV*) SvRV(AvARRAY(proclist)[i]));
+#endif
+}
+
+/**********************************************************************/
+/* Proc::Killall                                                      */
+/* killall() reads just the pid, start, fname and cmndline of each    */
+/* process, without building objects, and matches the pattern against */
+/* them right in the scan. The matches are signalled once the scan is */
+/* done, through a pidfd checked against the start time where there  */
+/* are pidfds, so a process that exited in the meantime can't have   */
+/* its pid reused by the time the signal goes out.                    */
+/**********************************************************************/
+typedef struct {
+  REGEXP* rx;
+  SV* str;                    /* the string matched, reused */
+  IV self;                    /* pid to leave alone, -1 for none */
+  IV* pids;
+  NV* starts;
+  int n, max;
+  int f_pid, f_start, f_fname, f_cmndline;
+} ppt_killall;
+
+static char* killall_names[] = { "pid", "start", "fname", "cmndline" };
+
+void collect_killall(ppt_ctx* ctx, ppt_rec* rec){
+  dTHX;
+  ppt_killall* k = (ppt_killall*) ctx->data;
+  ppt_val* val = NULL;
+  IV pid;
+  NV nv;
+
+  if( k->f_pid < 0 || k->f_pid >= rec->nvals || strcmp(rec->fields[k->f_pid], "pid") ){
+    k->f_pid = ppt_rec_field(rec, "pid");
+    k->f_start = ppt_rec_field(rec, "start");
+    k->f_fname = ppt_rec_field(rec, "fname");
+    k->f_cmndline = ppt_rec_field(rec, "cmndline");
+  }
+
+  /* the command line, or the name if there is none, as ps shows it */
+  if( k->f_cmndline >= 0 && rec->vals[k->f_cmndline].fmt == 's' &&
+      rec->vals[k->f_cmndline].u.str.len > 0 &&
+      !(rec->vals[k->f_cmndline].u.str.len == 1 && rec->vals[k->f_cmndline].u.str.pv[0] == '0') )
+    val = &rec->vals[k->f_cmndline];
+  else if( k->f_fname >= 0 && rec->vals[k->f_fname].fmt == 's' )
+    val = &rec->vals[k->f_fname];
+
+  if( val != NULL && (pid = ppt_rec_pid(rec, k->f_pid)) != k->self ){
+    sv_setpvn(k->str, val->u.str.pv, val->u.str.len);
+    if( pregexec(k->rx, SvPVX(k->str), SvEND(k->str), SvPVX(k->str), 0, k->str, 1) ){
+      if( k->n == k->max ){
+        k->max = k->max ? 2 * k->max : 16;
+        Renew(k->pids, k->max, IV);
+        Renew(k->starts, k->max, NV);
+      }
+      k->pids[k->n] = pid;
+      k->starts[k->n] = k->f_start >= 0 && ppt_val_num(&rec->vals[k->f_start], &nv) ? nv : -1;
+      k->n++;
+    }
+  }
+  ppt_rec_free(rec);
+}
+
+/* Send sig to the process; a negative sig goes to its process group */
+/* as with perl's kill                                                */
+static int killall_signal(IV pid, NV start, int sig){
+#ifdef PROCESSTABLE_PIDFD
+  ppt_handle* h;
+  int ok;
+
+  if( sig >= 0 ){
+    if( (h = handle_open(pid, start >= 0 ? &start : NULL)) == NULL )
+      return errno == ESRCH ? 0 : kill(pid, sig) == 0;
+    ok = handle_signal(h, sig) == 0 || (errno == ENOSYS && kill(pid, sig) == 0);
+    handle_free(h);
+    return ok;
+  }
+#endif
+  return sig >= 0 ? kill(pid, sig) == 0 : kill(-pid, -sig) == 0;
+}
+
+/**********************************************************************/
+/* Proc::Killfam                                                      */
+/* killfam() finds the descendants of its pids in the process tree of */
+/* one scan of just pid, ppid and start. With freeze => 1 it stops    */
+/* the whole family first, parents before their children, and then    */
+/* looks for children that were forked before their parent stopped:   */
+/* in the kernel's lists of children of the stopped processes where  */
+/* the OS code has them (OS_get_children), or in more scans until one */
+/* finds nothing new. Only then the signal goes out, and SIGCONT      */
+/* after it, so that stopped processes act on it.                     */
+/**********************************************************************/
+#ifdef PROCESSTABLE_OS_CHILDREN
+int OS_get_children(long, long*, int);
+#endif
+
+#define FAM_NEW    0          /* not signalled yet */
+#define FAM_PIDFD  1          /* signalled through handles[i] */
+#define FAM_PID    2          /* by pid, as there is no pidfd */
+#define FAM_GONE   3          /* exited, or its pid was reused */
+
+typedef struct {
+  IV* pids;
+  NV* starts;                 /* -1 if unknown */
+  char* state;
+#ifdef PROCESSTABLE_PIDFD
+  ppt_handle** handles;
+#endif
+  int n, max;
+  ppt_snap* snap;             /* the last scan */
+  char* in;                   /* member flag by index in snap */
+} ppt_family;
+
+static char* family_names[] = { "pid", "ppid", "start" };
+
+static void family_scan(ppt_family* f){
+  ppt_ctx ctx;
+  int i, k;
+
+  if( f->snap == NULL )
+    f->snap = snap_new(0);
+  else
+    snap_reset(f->snap);
+  Zero(&ctx, 1, ppt_ctx);
+  ctx.collect = collect_tree;
+  ctx.snap = f->snap;
+  ppt_scan(&ctx, -1, family_names, 3);
+  snap_finish(f->snap);
+
+  PptRenew(f->in, f->snap->n, char);
+  Zero(f->in, f->snap->n, char);
+  for( i = 0; i < f->n; i++ )
+    if( (k = snap_find(f->snap, f->pids[i])) >= 0 )
+      f->in[k] = 1;
+}
+
+static int family_has(ppt_family* f, IV pid){
+  int i;
+
+  if( (i = snap_find(f->snap, pid)) >= 0 )
+    return f->in[i];
+  for( i = 0; i < f->n; i++ )
+    if( f->pids[i] == pid )
+      return 1;
+  return 0;
+}
+
+static void family_add(ppt_family* f, IV pid, NV start){
+  int i;
+
+  if( f->n == f->max ){
+    f->max = f->max ? 2 * f->max : 64;
+    PptRenew(f->pids, f->max, IV);
+    PptRenew(f->starts, f->max, NV);
+    PptRenew(f->state, f->max, char);
+#ifdef PROCESSTABLE_PIDFD
+    PptRenew(f->handles, f->max, ppt_handle*);
+#endif
+  }
+  f->pids[f->n] = pid;
+  f->starts[f->n] = start;
+  f->state[f->n] = FAM_NEW;
+#ifdef PROCESSTABLE_PIDFD
+  f->handles[f->n] = NULL;
+#endif
+  f->n++;
+  if( (i = snap_find(f->snap, pid)) >= 0 )
+    f->in[i] = 1;
+}
+
+/* Process i of the snapshot and its descendants */
+static void family_add_tree(ppt_family* f, int i){
+  int* order;
+  int n, k;
+
+  PptNew(order, f->snap->n, int);
+  n = snap_subtree(f->snap, i, order);
+  for( k = 0; k < n; k++ )
+    if( !f->in[order[k]] )
+      family_add(f, f->snap->pid[order[k]], f->snap->start[order[k]]);
+  PptFree(order);
+}
+
+/* Send sig to member i; the first time, open a pidfd for it and */
+/* check its start time. A negative sig goes to its process group. */
+static int family_signal(ppt_family* f, int i, int sig){
+  if( sig < 0 )
+    return kill(-f->pids[i], -sig) == 0;
+#ifdef PROCESSTABLE_PIDFD
+  if( f->state[i] == FAM_NEW ){
+    if( (f->handles[i] = handle_open(f->pids[i], f->starts[i] >= 0 ? &f->starts[i] : NULL)) != NULL )
+      f->state[i] = FAM_PIDFD;
+    else
+      f->state[i] = errno == ESRCH ? FAM_GONE : FAM_PID;
+  }
+  if( f->state[i] == FAM_PIDFD ){
+    if( handle_signal(f->handles[i], sig) == 0 )
+      return 1;
+    if( errno != ENOSYS )
+      return 0;
+    f->state[i] = FAM_PID;
+  }
+#endif
+  if( f->state[i] == FAM_GONE ){
+    errno = ESRCH;
+    return 0;
+  }
+  return kill(f->pids[i], sig) == 0;
+}
+
+/* SIGSTOP takes effect asynchronously: a process that is in the middle */
+/* of a fork when it gets the signal finishes the fork first. Wait     */
+/* until member i is really stopped (or gone), so that its children    */
+/* are all there to be found. Processes that don't get to stop, like   */
+/* those stuck in the kernel, are given up on after a second.          */
+#ifdef PROCESSTABLE_GET_PROC
+static void family_wait_stopped(ppt_family* f, int i){
+  static char* names[] = { "state" };
+  ppt_ctx ctx;
+  ppt_rec* rec;
+  ppt_val* val;
+  NV deadline = 0;
+  int k, done;
+
+  if( f->state[i] == FAM_GONE || f->pids[i] == getpid() )
+    return;
+  for(;;){
+    rec = ppt_rec_read(&ctx, f->pids[i], names, 1);
+    done = rec == NULL || (k = ppt_rec_field(rec, "state")) < 0;
+    if( !done ){
+      val = &rec->vals[k];
+      done = val->fmt != 's' ||
+        (val->u.str.len == 4 && (memEQ(val->u.str.pv, "stop", 4) || memEQ(val->u.str.pv, "dead", 4))) ||
+        (val->u.str.len == 7 && memEQ(val->u.str.pv, "defunct", 7)) ||
+        (val->u.str.len == 11 && memEQ(val->u.str.pv, "tracingstop", 11));
+    }
+    if( rec != NULL )
+      ppt_rec_free(rec);
+    if( done )
+      return;
+    if( deadline == 0 )
+      deadline = monotonic_now() + 1;
+    else if( monotonic_now() > deadline )
+      return;
+    usleep(200);
+  }
+}
+#endif
+
+/* Stop the children of the stopped members that weren't seen yet, */
+/* until a pass over all of them finds no more                     */
+static void family_freeze(ppt_family* f){
+  int i, k, n = 0, added;
+#ifdef PROCESSTABLE_OS_CHILDREN
+  long* kids;
+  int maxkids = 64;
+
+  PptNew(kids, maxkids, long);
+  do{
+    added = 0;
+    for( i = 0; i < f->n; i++ ){
+      family_wait_stopped(f, i);
+      while( (n = OS_get_children(f->pids[i], kids, maxkids)) > maxkids ){
+        maxkids = 2 * n;
+        PptRenew(kids, maxkids, long);
+      }
+      if( n < 0 )
+        break;
+      /* a stopped parent doesn't reap them, so their pids are theirs */
+      for( k = 0; k < n; k++ ){
+        if( !family_has(f, kids[k]) ){
+          family_add(f, kids[k], -1);
+          family_signal(f, f->n - 1, SIGSTOP);
+          added++;
+        }
+      }
+    }
+  } while( n >= 0 && added );
+  PptFree(kids);
+  if( n >= 0 )
+    return;
+#endif
+
+  do{
+    added = 0;
+#ifdef PROCESSTABLE_GET_PROC
+    for( i = 0; i < f->n; i++ )
+      family_wait_stopped(f, i);
+#else
+    /* no way to read a single process: give the signals a moment */
+    usleep(10000);
+#endif
+    family_scan(f);
+    for( i = 0; i < f->n; i++ ){
+      if( (n = snap_find(f->snap, f->pids[i])) < 0 )
+        continue;
+      for( k = f->snap->kids_at[n]; k < f->snap->kids_at[n + 1]; k++ ){
+        if( !f->in[f->snap->kids[k]] ){
+          family_add(f, f->snap->pid[f->snap->kids[k]], -1);
+          family_signal(f, f->n - 1, SIGSTOP);
+          added++;
+        }
+      }
+    }
+  } while( added );
+}
+
+static void family_free(ppt_family* f){
+#ifdef PROCESSTABLE_PIDFD
+  int i;
+
+  for( i = 0; i < f->n; i++ )
+    if( f->handles[i] != NULL )
+      handle_free(f->handles[i]);
+  PptFree(f->handles);
+#endif
+  PptFree(f->pids);
+  PptFree(f->starts);
+  PptFree(f->state);
+  PptFree(f->in);
+  if( f->snap != NULL )
+    snap_free(f->snap);
+}
+
+/**********************************************************************/
+/* Accessors                                                          */
+/* Every field gets a real method in Proc::ProcessTable::Process and  */
+/* in Proc::ProcessTable::Process::View instead of going through      */
+/* AUTOLOAD. They share two XSUBs that find the field in their ANY    */
+/* slot: the field name with its hash precomputed, and for views the  */
+/* index of the field in the records. This is plain C data, as the    */
+/* XSUBs are shared by the interpreters cloned for ithreads.          */
+/**********************************************************************/
+typedef struct {
+  char* name;
+  I32 len;
+  U32 hash;
+  int idx;                    /* field index for views, -1 if unknown yet */
+} ppt_accessor;
+
+XS(XS_Proc__ProcessTable__Process_accessor){
+  dXSARGS;
+  ppt_accessor* acc = (ppt_accessor*) CvXSUBANY(cv).any_ptr;
+  HV* hash;
+  SV** svp;
+
+  if( items < 1 || !SvROK(ST(0)) || SvTYPE(SvRV(ST(0))) != SVt_PVHV )
+    croak("%s is not an object", items ? SvPV_nolen(ST(0)) : "undef");
+  hash = (HV*) SvRV(ST(0));
+
+  /* like AUTOLOAD, only fields the object has; setting one doesn't */
+  /* add it                                                          */
+  if( (svp = (SV**) hv_common_key_len(hash, acc->name, acc->len,
+				      HV_FETCH_JUST_SV, NULL, acc->hash)) == NULL )
+    croak("Can't access `%s' field in class %s", acc->name,
+	  SvOBJECT(hash) ? HvNAME(SvSTASH(hash)) : "HASH");
+  if( items > 1 )
+    svp = (SV**) hv_common_key_len(hash, acc->name, acc->len,
+				   HV_FETCH_ISSTORE | HV_FETCH_JUST_SV,
+				   newSVsv(ST(1)), acc->hash);
+
+  /* a copy, as AUTOLOAD returned: not the element itself */
+  ST(0) = sv_mortalcopy(*svp);
+  XSRETURN(1);
+}
+
+XS(XS_Proc__ProcessTable__Process__View_accessor){
+  dXSARGS;
+  ppt_accessor* acc = (ppt_accessor*) CvXSUBANY(cv).any_ptr;
+  ppt_snap* snap;
+  ppt_rec* rec;
+  SV** snap_sv;
+  SV** i_sv;
+  SV* val;
+  int i;
+
+  if( items < 1 || !SvROK(ST(0)) || SvTYPE(SvRV(ST(0))) != SVt_PVAV ||
+      (snap_sv = av_fetch((AV*) SvRV(ST(0)), 0, 0)) == NULL ||
+      (i_sv = av_fetch((AV*) SvRV(ST(0)), 1, 0)) == NULL )
+    croak("%s is not a process view", items ? SvPV_nolen(ST(0)) : "undef");
+  if( items > 1 )
+    croak("Can't set `%s' field of a process view", acc->name);
+
+  snap = snap_from_sv(*snap_sv);
+  i = SvIV(*i_sv);
+  if( !snap->packed || i < 0 || i >= snap->n )
+    croak("Invalid process view");
+  rec = snap->recs[i];
+
+  /* all records of a system have the same fields */
+  if( acc->idx < 0 || acc->idx >= rec->nvals || strcmp(rec->fields[acc->idx], acc->name) )
+    acc->idx = ppt_rec_field(rec, acc->name);
+
+  if( acc->idx >= 0 )
+    val = ppt_val_sv(&rec->vals[acc->idx]);
+  else if( (val = snap_field(snap, i, acc->name)) == NULL )
+    croak("Can't access `%s' field in class Proc::ProcessTable::Process::View", acc->name);
+
+  ST(0) = sv_2mortal(val);
+  XSRETURN(1);
+}
+
+static void install_accessor_in(const char* class, const char* name, XSUBADDR_t xsub){
+  dTHX;
+  ppt_accessor* acc;
+  SV* fullname;
+  CV* cv;
+
+  fullname = sv_2mortal(newSVpvf("%s::%s", class, name));
+  /* don't replace real methods like kill or priority */
+  if( get_cv(SvPVX(fullname), 0) != NULL )
+    return;
+
+  Newx(acc, 1, ppt_accessor);
+  acc->len = strlen(name);
+  acc->name = savepvn(name, acc->len);
+  PERL_HASH(acc->hash, acc->name, acc->len);
+  acc->idx = -1;
+  cv = newXS(SvPVX(fullname), xsub, __FILE__);
+  CvXSUBANY(cv).any_ptr = acc;
+}
+
+void install_accessor(const char* name){
+  install_accessor_in("Proc::ProcessTable::Process", name,
+		      XS_Proc__ProcessTable__Process_accessor);
+  install_accessor_in("Proc::ProcessTable::Process::View", name,
+		      XS_Proc__ProcessTable__Process__View_accessor);
+}
+
+/* Is name a field of the OS code, ttydev or a total of rollup()? */
+/* Other keys, like Handle, don't get an accessor.                */
+static int accessor_known(const char* name){
+  int i;
+
+  if( !strcmp(name, "ttydev") || !strcmp(name, "tree_count") )
+    return 1;
+  for( i = 0; i < NROLL; i++ )
+    if( !strncmp(name, "tree_", 5) && !strcmp(name + 5, roll_fields[i]) )
+      return 1;
+  for( i = 0; Fields != NULL && i < Numfields; i++ )
+    if( !strcmp(name, Fields[i]) )
+      return 1;
+  return 0;
+}
+
+/* Accessors for all fields of the OS code, and ttydev */
+void install_accessors(char** fields, int nfields){
+  int i;
+
+  for( i = 0; i < nfields; i++ )
+    install_accessor(fields[i]);
+  install_accessor("ttydev");
+}
+
+/**********************************************************************/
+/* Sort keys                                                          */
+/* A key is a field name with an optional leading '-' (descending) or */
+/* '+' (ascending). Numeric fields compare numerically; so do string  */
+/* fields whose values look like numbers (pctcpu, pctmem), all other  */
+/* strings compare bytewise. Undefined values always sort last.       */
+/**********************************************************************/
+typedef struct {
+  char* name;
+  int desc;
+  int idx;                    /* field index, resolved on the first record */
+} ppt_key;
+
+static int ppt_val_cmp(ppt_val* a, ppt_val* b){
+  NV na, nb;
+  int a_num, b_num, a_def, b_def;
+  int len;
+
+  a_def = isLOWER(a->fmt) && a->fmt != 'a';
+  b_def = isLOWER(b->fmt) && b->fmt != 'a';
+  if( !a_def || !b_def )
+    return b_def - a_def;
+
+  a_num = ppt_val_num(a, &na);
+  b_num = ppt_val_num(b, &nb);
+  if( a_num && b_num )
+    return (na > nb) - (na < nb);
+  if( a_num != b_num )
+    return b_num - a_num;     /* numbers before strings */
+  if( a->fmt != 's' || b->fmt != 's' )
+    return 0;
+
+  len = a->u.str.len < b->u.str.len ? a->u.str.len : b->u.str.len;
+  if( (len = memcmp(a->u.str.pv, b->u.str.pv, len)) != 0 )
+    return len;
+  return (a->u.str.len > b->u.str.len) - (a->u.str.len < b->u.str.len);
+}
+
+/* < 0 if a ranks before b under keys */
+static int ppt_rec_cmp(ppt_rec* a, ppt_rec* b, ppt_key* keys, int nkeys){
+  ppt_val *va, *vb;
+  int i, c;
+
+  for( i = 0; i < nkeys; i++ ){
+    va = &a->vals[keys[i].idx];
+    vb = &b->vals[keys[i].idx];
+    c = ppt_val_cmp(va, vb);
+    /* undefined values stay last in both directions */
+    if( keys[i].desc && isLOWER(va->fmt) && isLOWER(vb->fmt) )
+      c = -c;
+    if( c )
+      return c;
+  }
+  return 0;
+}
+
+/* Build a key list from a perl array of field names; with sortspec a
+   leading '-' or '+' sets the direction */
+static ppt_key* ppt_keys_new(AV* names, int* nkeys, int sortspec){
+  dTHX;
+  ppt_key* keys;
+  SV** name_sv;
+  char* name;
+  int i;
+
+  *nkeys = names ? av_len(names) + 1 : 0;
+  Newxz(keys, *nkeys + 1, ppt_key);
+  for( i = 0; i < *nkeys; i++ ){
+    name_sv = av_fetch(names, i, 0);
+    name = name_sv ? SvPV_nolen(*name_sv) : "";
+    if( sortspec && (*name == '-' || *name == '+') )
+      keys[i].desc = (*name++ == '-');
+    keys[i].name = savepv(name);
+    keys[i].idx = -1;
+  }
+  return keys;
+}
+
+static void ppt_keys_free(ppt_key* keys, int nkeys){
+  int i;
+
+  for( i = 0; i < nkeys; i++ )
+    Safefree(keys[i].name);
+  Safefree(keys);
+}
+
+/* Resolve the key names against the fields of a record; returns the
+   first unknown name or NULL */
+static char* ppt_keys_resolve(ppt_key* keys, int nkeys, ppt_rec* rec){
+  int i;
+
+  for( i = 0; i < nkeys; i++ ){
+    if( (keys[i].idx = ppt_rec_field(rec, keys[i].name)) < 0 )
+      return keys[i].name;
+  }
+  return NULL;
+}
+
+/**********************************************************************/
+/* $t->apply                                                          */
+/* Selects processes by the fields in where, reading only those (and  */
+/* pid and start) where the OS code can, and matches them right in    */
+/* the scan. Each criterion is a list of alternatives: values, equal  */
+/* as numbers or as strings, or qr// patterns. The operations go out  */
+/* once the scan is done, to each process in turn, and stop at the    */
+/* first that fails for it; its errno is the result for that pid.    */
+/**********************************************************************/
+#ifdef PROCESSTABLE_SETSCHED
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+#include <sys/resource.h>
+
+typedef struct {
+  ppt_key* keys;              /* the fields of where */
+  int nkeys;
+  AV** alts;                  /* and their alternatives */
+  SV* str;                    /* a value as a string, for patterns */
+  IV self;
+  IV* pids;
+  NV* starts;
+  int n, max;
+  int f_pid, f_start;
+  int resolved;
+  char* bad_key;
+} ppt_apply;
+
+/* Does the value of a field match one of the alternatives */
+static int apply_match(ppt_apply* a, ppt_val* val, AV* alts){
+  dTHX;
+  REGEXP* rx;
+  SV* alt;
+  STRLEN len;
+  char* pv;
+  NV nv;
+  int isnum, i;
+
+  isnum = val->fmt != 's' && ppt_val_num(val, &nv);
+  if( val->fmt != 's' && !isnum )
+    return 0;
+  for( i = 0; i <= av_len(alts); i++ ){
+    alt = *av_fetch(alts, i, 1);
+    if( (rx = SvRX(alt)) != NULL ){
+      if( isnum )
+        sv_setnv(a->str, nv);
+      else
+        sv_setpvn(a->str, val->u.str.pv, val->u.str.len);
+      pv = SvPV(a->str, len);
+      if( pregexec(rx, pv, pv + len, pv, 0, a->str, 1) )
+        return 1;
+    }
+    else if( isnum ){
+      if( looks_like_number(alt) && SvNV(alt) == nv )
+        return 1;
+    }
+    else{
+      pv = SvPV(alt, len);
+      if( len == val->u.str.len && memEQ(pv, val->u.str.pv, len) )
+        return 1;
+    }
+  }
+  return 0;
+}
+
+void collect_apply(ppt_ctx* ctx, ppt_rec* rec){
+  ppt_apply* a = (ppt_apply*) ctx->data;
+  IV pid;
+  NV nv;
+  int i;
+
+  if( !a->resolved ){
+    a->bad_key = ppt_keys_resolve(a->keys, a->nkeys, rec);
+    a->f_pid = ppt_rec_field(rec, "pid");
+    a->f_start = ppt_rec_field(rec, "start");
+    a->resolved = 1;
+  }
+  if( a->bad_key || (pid = ppt_rec_pid(rec, a->f_pid)) < 0 || pid == a->self ){
+    ppt_rec_free(rec);
+    return;
+  }
+  for( i = 0; i < a->nkeys; i++ ){
+    if( !apply_match(a, &rec->vals[a->keys[i].idx], a->alts[i]) ){
+      ppt_rec_free(rec);
+      return;
+    }
+  }
+
+  if( a->n == a->max ){
+    a->max = a->max ? 2 * a->max : 16;
+    Renew(a->pids, a->max, IV);
+    Renew(a->starts, a->max, NV);
+  }
+  a->pids[a->n] = pid;
+  a->starts[a->n] = a->f_start >= 0 && ppt_val_num(&rec->vals[a->f_start], &nv) ? nv : -1;
+  a->n++;
+  ppt_rec_free(rec);
+}
+
+/* The operations of apply for one process; 0 or the errno of the */
+/* first that failed                                              */
+typedef struct {
+  int nice, set_nice;
+  int ioprio;                 /* -1 to leave it */
+  int ncpus;                  /* -1 to leave the affinity */
+  int* cpus;
+  int sig, set_sig;
+} ppt_apply_ops;
+
+#ifdef PROCESSTABLE_PIDFD
+/* The pid still belongs to the process of the pidfd if the pidfd    */
+/* reaches it after a call on the bare pid: then the call hit it too */
+static int apply_recheck(ppt_handle* h, int err){
+  if( h != NULL && handle_signal(h, 0) < 0 && errno == ESRCH )
+    return ESRCH;
+  return err;
+}
+#else
+#define apply_recheck(h, err) (err)
+#endif
+
+static int apply_ops(IV pid, NV start, ppt_apply_ops* ops){
+  int err = 0;
+#ifdef PROCESSTABLE_PIDFD
+  ppt_handle* h;
+
+  /* a pidfd checked against the start time makes sure it is still */
+  /* the process that matched, and the signal goes through it       */
+  if( (h = handle_open(pid, start >= 0 ? &start : NULL)) == NULL && errno == ESRCH )
+    return ESRCH;
+#endif
+
+  if( ops->set_nice ){
+    if( setpriority(PRIO_PROCESS, pid, ops->nice) < 0 )
+      err = errno;
+    err = apply_recheck(h, err);
+  }
+  if( !err && ops->ioprio >= 0 ){
+#if defined(PROCESSTABLE_SETSCHED) && defined(SYS_ioprio_set)
+    /* IOPRIO_WHO_PROCESS */
+    if( syscall(SYS_ioprio_set, 1, (int) pid, ops->ioprio) < 0 )
+      err = errno;
+    err = apply_recheck(h, err);
+#else
+    err = ENOSYS;
+#endif
+  }
+  if( !err && ops->ncpus >= 0 ){
+#ifdef PROCESSTABLE_SETSCHED
+    cpu_set_t set;
+    int i;
+
+    CPU_ZERO(&set);
+    for( i = 0; i < ops->ncpus; i++ ){
+      if( ops->cpus[i] < 0 || ops->cpus[i] >= CPU_SETSIZE )
+        err = EINVAL;
+      else
+        CPU_SET(ops->cpus[i], &set);
+    }
+    if( !err ){
+      if( sched_setaffinity(pid, sizeof(set), &set) < 0 )
+        err = errno;
+      err = apply_recheck(h, err);
+    }
+#else
+    err = ENOSYS;
+#endif
+  }
+  if( !err && ops->set_sig ){
+#ifdef PROCESSTABLE_PIDFD
+    if( h != NULL && ops->sig >= 0 ){
+      if( handle_signal(h, ops->sig) < 0 )
+        err = errno;
+    }
+    else
+#endif
+    if( !killall_signal(pid, -1, ops->sig) )
+      err = errno;
+  }
+
+#ifdef PROCESSTABLE_PIDFD
+  if( h != NULL )
+    handle_free(h);
+#endif
+  return err;
+}
+
+/**********************************************************************/
+/* Top-N selection                                                    */
+/* A bounded heap of the k best records seen so far, the worst one at */
+/* the root. Records that don't make it are freed right away, so only */
+/* the winners are ever turned into perl objects.                     */
+/**********************************************************************/
+typedef struct {
+  ppt_rec** heap;
+  int n;
+  int k;
+  ppt_key* keys;
+  int nkeys;
+  int resolved;
+  char* bad_key;              /* unknown key name, reported after the scan */
+} ppt_topn;
+
+
+static void topn_sift_down(ppt_topn* t, int i){
+  ppt_rec* tmp;
+  int child;
+
+  while( (child = 2 * i + 1) < t->n ){
+    if( child + 1 < t->n &&
+	ppt_rec_cmp(t->heap[child + 1], t->heap[child], t->keys, t->nkeys) > 0 )
+      child++;
+    if( ppt_rec_cmp(t->heap[child], t->heap[i], t->keys, t->nkeys) <= 0 )
+      break;
+    tmp = t->heap[i]; t->heap[i] = t->heap[child]; t->heap[child] = tmp;
+    i = child;
+  }
+}
+
+static void topn_sift_up(ppt_topn* t, int i){
+  ppt_rec* tmp;
+  int parent;
+
+  while( i > 0 ){
+    parent = (i - 1) / 2;
+    if( ppt_rec_cmp(t->heap[i], t->heap[parent], t->keys, t->nkeys) <= 0 )
+      break;
+    tmp = t->heap[i]; t->heap[i] = t->heap[parent]; t->heap[parent] = tmp;
+    i = parent;
+  }
+}
+
+/* The top() sink */
+void collect_topn(ppt_ctx* ctx, ppt_rec* rec){
+  ppt_topn* t = (ppt_topn*) ctx->data;
+
+  if( !t->resolved ){
+    t->bad_key = ppt_keys_resolve(t->keys, t->nkeys, rec);
+    t->resolved = 1;
+  }
+  if( t->bad_key ){
+    ppt_rec_free(rec);
+    return;
+  }
+
+  if( t->n < t->k ){
+    t->heap[t->n++] = rec;
+    topn_sift_up(t, t->n - 1);
+  }
+  else if( ppt_rec_cmp(rec, t->heap[0], t->keys, t->nkeys) < 0 ){
+    ppt_rec_free(t->heap[0]);
+    t->heap[0] = rec;
+    topn_sift_down(t, 0);
+  }
+  else{
+    ppt_rec_free(rec);
+  }
+}
+
+/* Empties the heap into an array, best record first */
+static AV* topn_harvest(ppt_topn* t, HV* ttydevs){
+  dTHX;
+  AV* av = newAV();
+  int i;
+
+  av_extend(av, t->n - 1);
+  for( i = t->n - 1; i >= 0; i-- ){
+    ppt_rec* worst = t->heap[0];
+    t->heap[0] = t->heap[--t->n];
+    topn_sift_down(t, 0);
+    av_store(av, i, ppt_rec_bless(ttydevs, worst));
+    ppt_rec_free(worst);
+  }
+  return av;
+}
+
+/**********************************************************************/
+/* Group-by aggregation                                               */
+/* Records are folded into per-group counters in an open addressing   */
+/* hash table keyed on the serialized values of the group fields, and */
+/* freed right away. Only one small hash per group is built.          */
+/**********************************************************************/
+typedef struct {
+  char* key;                  /* serialized group values */
+  int keylen;
+  U32 hash;
+  ppt_val* vals;              /* copies of the group values */
+  UV count;
+  NV* acc;                    /* sums, then mins, then maxes */
+  char* seen;                 /* for each acc, has it got a value yet */
+} ppt_group;
+
+typedef struct {
+  ppt_key* by;
+  int nby;
+  ppt_key* sum;
+  int nsum;
+  ppt_key* min;
+  int nmin;
+  ppt_key* max;
+  int nmax;
+  int resolved;
+  char* bad_key;
+  ppt_group** slots;          /* hash table, size is a power of two */
+  int nslots;
+  ppt_group** groups;         /* the same groups in the order first seen */
+  int ngroups;
+  int maxgroups;
+  char* keybuf;               /* scratch space for serializing a key */
+  int keybufsize;
+} ppt_aggr;
+
+
+/* FNV-1a */
+static U32 ppt_hash(const char* s, int len){
+  U32 h = 2166136261U;
+
+  while( len-- > 0 ){
+    h ^= (unsigned char) *s++;
+    h *= 16777619U;
+  }
+  return h;
+}
+
+static void aggr_keybuf_add(ppt_aggr* a, int* len, const void* data, int size){
+  if( *len + size > a->keybufsize ){
+    a->keybufsize = (*len + size) * 2;
+    Renew(a->keybuf, a->keybufsize, char);
+  }
+  memcpy(a->keybuf + *len, data, size);
+  *len += size;
+}
+
+/* Serialize the group values of a record into keybuf */
+static int aggr_key(ppt_aggr* a, ppt_rec* rec){
+  ppt_val* val;
+  int i, len = 0;
+
+  for( i = 0; i < a->nby; i++ ){
+    val = &rec->vals[a->by[i].idx];
+    aggr_keybuf_add(a, &len, &val->fmt, 1);
+    switch(val->fmt)
+      {
+      case 'i': case 'l': case 'j':
+	aggr_keybuf_add(a, &len, &val->u.iv, sizeof(IV));
+	break;
+      case 'u': case 'p':
+	aggr_keybuf_add(a, &len, &val->u.uv, sizeof(UV));
+	break;
+      case 's': case 'a':
+	aggr_keybuf_add(a, &len, &val->u.str.len, sizeof(int));
+	aggr_keybuf_add(a, &len, val->u.str.pv, val->u.str.len);
+	break;
+      case 'V':
+	aggr_keybuf_add(a, &len, &val->u.sv, sizeof(SV*));
+	break;
+      }
+  }
+  return len;
+}
+
+static void aggr_grow(ppt_aggr* a){
+  ppt_group** slots;
+  int nslots, i, j;
+
+  nslots = a->nslots ? a->nslots * 2 : 64;
+  Newxz(slots, nslots, ppt_group*);
+  for( i = 0; i < a->ngroups; i++ ){
+    for( j = a->groups[i]->hash & (nslots - 1); slots[j]; j = (j + 1) & (nslots - 1) )
+      ;
+    slots[j] = a->groups[i];
+  }
+  Safefree(a->slots);
+  a->slots = slots;
+  a->nslots = nslots;
+}
+
+static ppt_group* aggr_group(ppt_aggr* a, ppt_rec* rec){
+  ppt_group* g;
+  int keylen, nacc, i, j;
+  U32 hash;
+
+  keylen = aggr_key(a, rec);
+  hash = ppt_hash(a->keybuf, keylen);
+
+  for( j = hash & (a->nslots - 1); (g = a->slots[j]) != NULL; j = (j + 1) & (a->nslots - 1) ){
+    if( g->hash == hash && g->keylen == keylen && !memcmp(g->key, a->keybuf, keylen) )
+      return g;
+  }
+
+  /* a new group */
+  nacc = a->nsum + a->nmin + a->nmax;
+  Newxz(g, 1, ppt_group);
+  g->key = savepvn(a->keybuf, keylen);
+  g->keylen = keylen;
+  g->hash = hash;
+  Newxz(g->acc, nacc + 1, NV);
+  Newxz(g->seen, nacc + 1, char);
+  Newx(g->vals, a->nby + 1, ppt_val);
+  for( i = 0; i < a->nby; i++ ){
+    g->vals[i] = rec->vals[a->by[i].idx];
+    if( g->vals[i].fmt == 's' || g->vals[i].fmt == 'a' )
+      g->vals[i].u.str.pv = savepvn(g->vals[i].u.str.pv, g->vals[i].u.str.len);
+    else if( g->vals[i].fmt == 'V' )
+      SvREFCNT_inc(g->vals[i].u.sv);
+  }
+
+  if( a->ngroups == a->maxgroups ){
+    a->maxgroups = a->maxgroups ? a->maxgroups * 2 : 64;
+    Renew(a->groups, a->maxgroups, ppt_group*);
+  }
+  a->groups[a->ngroups++] = g;
+  a->slots[j] = g;
+
+  /* keep the load factor below 1/2 */
+  if( a->ngroups * 2 > a->nslots )
+    aggr_grow(a);
+
+  return g;
+}
+
+/* The aggregate() sink */
+void collect_aggr(ppt_ctx* ctx, ppt_rec* rec){
+  ppt_aggr* a = (ppt_aggr*) ctx->data;
+  ppt_group* g;
+  NV nv;
+  int i, n;
+
+  if( !a->resolved ){
+    if( (a->bad_key = ppt_keys_resolve(a->by, a->nby, rec)) == NULL &&
+	(a->bad_key = ppt_keys_resolve(a->sum, a->nsum, rec)) == NULL &&
+	(a->bad_key = ppt_keys_resolve(a->min, a->nmin, rec)) == NULL )
+      a->bad_key = ppt_keys_resolve(a->max, a->nmax, rec);
+    a->resolved = 1;
+  }
+  if( a->bad_key ){
+    ppt_rec_free(rec);
+    return;
+  }
+
+  g = aggr_group(a, rec);
+  g->count++;
+
+  for( i = 0; i < a->nsum; i++ ){
+    if( ppt_val_num(&rec->vals[a->sum[i].idx], &nv) ){
+      g->acc[i] += nv;
+      g->seen[i] = 1;
+    }
+  }
+  for( i = 0, n = a->nsum; i < a->nmin; i++, n++ ){
+    if( ppt_val_num(&rec->vals[a->min[i].idx], &nv) && (!g->seen[n] || nv < g->acc[n]) ){
+      g->acc[n] = nv;
+      g->seen[n] = 1;
+    }
+  }
+  for( i = 0, n = a->nsum + a->nmin; i < a->nmax; i++, n++ ){
+    if( ppt_val_num(&rec->vals[a->max[i].idx], &nv) && (!g->seen[n] || nv > g->acc[n]) ){
+      g->acc[n] = nv;
+      g->seen[n] = 1;
+    }
+  }
+
+  ppt_rec_free(rec);
+}
+
+static void aggr_store(HV* hv, const char* prefix, ppt_key* keys, int nkeys,
+		       ppt_group* g, int n){
+  dTHX;
+  SV* name;
+  int i;
+
+  for( i = 0; i < nkeys; i++, n++ ){
+    name = sv_2mortal(newSVpvf("%s_%s", prefix, keys[i].name));
+    hv_store(hv, SvPVX(name), SvCUR(name),
+	     g->seen[n] ? newSVnv(g->acc[n]) : newSV(0), 0);
+  }
+}
+
+/* One hash per group, in the order the groups were first seen */
+static AV* aggr_harvest(ppt_aggr* a, int count){
+  dTHX;
+  AV* av = newAV();
+  HV* hv;
+  ppt_group* g;
+  int i, j;
+
+  for( i = 0; i < a->ngroups; i++ ){
+    g = a->groups[i];
+    hv = newHV();
+    for( j = 0; j < a->nby; j++ )
+      hv_store(hv, a->by[j].name, strlen(a->by[j].name),
+	       g->vals[j].fmt == 'A' ? newSV(0) : ppt_val_sv(&g->vals[j]), 0);
+    if( count )
+      hv_store(hv, "count", 5, newSVuv(g->count), 0);
+    aggr_store(hv, "sum", a->sum, a->nsum, g, 0);
+    aggr_store(hv, "min", a->min, a->nmin, g, a->nsum);
+    aggr_store(hv, "max", a->max, a->nmax, g, a->nsum + a->nmin);
+    av_push(av, newRV_noinc((SV*) hv));
+  }
+  return av;
+}
+
+static void aggr_free(ppt_aggr* a){
+  dTHX;
+  ppt_group* g;
+  int i, j;
+
+  for( i = 0; i < a->ngroups; i++ ){
+    g = a->groups[i];
+    for( j = 0; j < a->nby; j++ ){
+      if( g->vals[j].fmt == 's' || g->vals[j].fmt == 'a' )
+	Safefree(g->vals[j].u.str.pv);
+      else if( g->vals[j].fmt == 'V' )
+	SvREFCNT_dec(g->vals[j].u.sv);
+    }
+    Safefree(g->vals);
+    Safefree(g->key);
+    Safefree(g->acc);
+    Safefree(g->seen);
+    Safefree(g);
+  }
+  Safefree(a->groups);
+  Safefree(a->slots);
+  Safefree(a->keybuf);
+  ppt_keys_free(a->by, a->nby);
+  ppt_keys_free(a->sum, a->nsum);
+  ppt_keys_free(a->min, a->nmin);
+  ppt_keys_free(a->max, a->nmax);
+}
+
+/**********************************************************************/
+/* Generic funcs generated by h2xs                                    */
+/**********************************************************************/
+
+static int
+not_here(s)
+char *s;
+{
+    croak("%s not implemented on this architecture", s);
+    return -1;
+}
+
+static double
+constant(name, arg)
+char *name;
+int arg;
+{
+    errno = 0;
+    switch (*name) {
+    }
+    errno = EINVAL;
+    return 0;
+
+not_there:
+    errno = ENOENT;
+    return 0;
+}
+
+#ifdef	PROCESSTABLE_THREAD
+pthread_mutex_t _mutex_table;
+pthread_mutex_t _mutex_new;
+
+void
+mutex_op(int lock, pthread_mutex_t *mutex)
+{
+	if (lock == 0) {	/*unlock*/
+		pthread_mutex_unlock(mutex);
+	} else {		/*lock*/
+		pthread_mutex_lock(mutex);
+	}
+}
+#endif
+
+void
+mutex_new(int lock)
+{
+#ifdef	PROCESSTABLE_THREAD
+	mutex_op(lock, &_mutex_new);
+#endif
+}
+
+/* OS code that keeps no state between calls (PROCESSTABLE_OS_REENTRANT) */
+/* can scan in several threads at once; the rest of the scan state is    */
+/* per interpreter and per call anyway. The globals set up by the first  */
+/* scan are only safe without the lock when they were set up at BOOT     */
+/* (PROCESSTABLE_OS_FIELDS).                                             */
+void
+mutex_table(int lock)
+{
+#if defined(PROCESSTABLE_THREAD) && !(defined(PROCESSTABLE_OS_REENTRANT) && defined(PROCESSTABLE_OS_FIELDS))
+	mutex_op(lock, &_mutex_table);
+#endif
+}
+
+MODULE = Proc::ProcessTable		PACKAGE = Proc::ProcessTable		
+PROTOTYPES: DISABLE
+
+BOOT:
+#ifdef	PROCESSTABLE_THREAD
+	pthread_mutex_init(&_mutex_table, NULL);
+	pthread_mutex_init(&_mutex_new, NULL);
+#endif
+#ifdef	PROCESSTABLE_SAMPLER
+	pthread_once(&Sampler_once, sampler_init);
+#endif
+#ifdef	PROCESSTABLE_OS_FIELDS
+	fields_os();
+#endif
+	{
+	  MY_CXT_INIT;
+	  MY_CXT.ctx = NULL;
+	  MY_CXT.states = NULL;
+	  MY_CXT.accessors = 0;
+#ifdef	PROCESSTABLE_OS_FIELDS
+	  /* ProcessTable.pm uses Process.pm before bootstrap, so the real
+	     methods are there already and are left alone */
+	  install_accessors(Fields, Numfields);
+	  MY_CXT.accessors = 1;
+#endif
+	}
+
+void
+CLONE(...)
+	CODE:
+	MY_CXT_CLONE;
+	/* the hash belongs to the parent interpreter; the accessors
+	   were cloned with the rest of the package */
+	MY_CXT.ctx = NULL;
+	MY_CXT.states = NULL;
+
+void
+mutex_new(lock)
+	int lock
+
+void
+mutex_table(lock)
+	int lock
+
+double
+constant(name,arg)
+	char *		name
+	int		arg
+
+SV*
+table(obj, ...)
+     SV*  obj
+     CODE:
+
+     /* Check that we have an actual object. 
+       calling Proc::Processtable->table SIGSEVs
+       calling on an actual object is valid my $proc_obj = Proc::ProcessTable->new; $proc_obj->table; 
+     */
+     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
+         croak("Must call table from an initalized object created with new");
+     }
+
+
+     HV* hash;
+     SV** fetched;
+     SV* snap_sv;
+     char* opt;
+     int packed = 0;
+     int refresh = 0;
+     int pidfds = 0;
+     ppt_ctx ctx;
+     ppt_prev prev;
+     SV* prev_sv = NULL;
+     int i;
+
+     if( items % 2 == 0 )
+       croak("Odd number of options passed to table");
+     for( i = 1; i < items; i += 2 ){
+       opt = SvPV_nolen(ST(i));
+       if( !strcmp(opt, "packed") )
+         packed = SvTRUE(ST(i + 1));
+       else if( !strcmp(opt, "refresh") )
+         refresh = SvTRUE(ST(i + 1));
+       else if( !strcmp(opt, "pidfds") )
+         pidfds = SvTRUE(ST(i + 1));
+       else
+         croak("Unknown option `%s' passed to table", opt);
+     }
+     if( pidfds && !PPT_PIDFDS )
+       croak("table: pidfds are not supported on this system");
+     if( pidfds && packed )
+       croak("table: pidfds need process objects, not a packed table");
+
+
+     /* dereference our object to a hash */
+     hash = (HV*) SvRV(obj);
+     Zero(&ctx, 1, ppt_ctx);
+
+     /* A packed table is a snapshot of its own, with no process objects */
+     if( packed ){
+       hv_delete(hash, "Table", 5, G_DISCARD);
+       ctx.snap = snap_new(1);
+       snap_sv = sv_setref_pv(newSV(0), "Proc::ProcessTable::Snapshot", ctx.snap);
+       hv_store(hash, "Snapshot", 8, snap_sv, 0);
+
+       ctx.collect = collect_packed;
+       ppt_scan(&ctx, -1, NULL, 0);
+
+       snap_finish(ctx.snap);
+       RETVAL = newSVsv(snap_sv);
+       ST(0) = sv_2mortal(RETVAL);
+       XSRETURN(1);
+     }
+
+     ctx.collect = collect_proclist;
+
+     /* If the Table array already exists on our object we clear it
+        and store a pointer to it in ctx.proclist */
+     if( hv_exists(hash, "Table", 5) ){
+       /* fetch the hash entry */
+       fetched = hv_fetch(hash, "Table", 5, 0);
+       /* what's stored in the hash is a ref to the array, so we need
+          to dereference it */
+       ctx.proclist = (AV*) SvRV(*fetched);
+
+       /* For a refresh, hold on to the old objects and their snapshot */
+       prev.snap = snap_of(obj);
+       if( refresh && prev.snap && !prev.snap->packed ){
+         prev_sv = SvREFCNT_inc(*hv_fetch(hash, "Snapshot", 8, 0));
+         prev.n = av_len(ctx.proclist) + 1;
+         Newx(prev.objs, prev.n, SV*);
+         for( i = 0; i < prev.n; i++ )
+           prev.objs[i] = SvREFCNT_inc(AvARRAY(ctx.proclist)[i]);
+         /* the new table needs a snapshot of its own */
+         hv_store(hash, "Snapshot", 8,
+                  sv_setref_pv(newSV(0), "Proc::ProcessTable::Snapshot", snap_new(0)), 0);
+         ctx.collect = collect_refresh;
+         ctx.data = &prev;
+       }
+       av_clear(ctx.proclist);
+     }
+     else{
+       /* Otherwise we create the array and store it on the object. */
+       ctx.proclist = newAV();
+       hv_store(hash, "Table", 5, newRV_noinc((SV*)ctx.proclist), 0);
+     }
+
+     /* Keep the C side index of this table on the object as well; packed
+        snapshots belong to whoever holds them, so don't reuse those */
+     if( (ctx.snap = snap_of(obj)) == NULL || ctx.snap->packed ){
+       ctx.snap = snap_new(0);
+       hv_store(hash, "Snapshot", 8,
+                sv_setref_pv(newSV(0), "Proc::ProcessTable::Snapshot", ctx.snap), 0);
+     }
+     snap_reset(ctx.snap);
+
+     /* Call get_table to build the process objects and push them onto
+        the Table array */
+     ppt_scan(&ctx, -1, NULL, 0);
+
+     snap_finish(ctx.snap);
+
+     /* Drop the objects of processes that exited */
+     if( ctx.data ){
+       for( i = 0; i < prev.n; i++ )
+         SvREFCNT_dec(prev.objs[i]);
+       Safefree(prev.objs);
+       SvREFCNT_dec(prev_sv);
+     }
+
+     if( pidfds )
+       table_handles(ctx.proclist);
+
+     /* Return a ref to our process list */
+     RETVAL = newRV_inc((SV*) ctx.proclist);
+
+     OUTPUT:
+     RETVAL
+
+SV*
+_top(obj, n, by)
+     SV*  obj
+     int  n
+     AV*  by
+     CODE:
+
+     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
+         croak("Must call top from an initalized object created with new");
+     }
+
+     ppt_topn top;
+     ppt_ctx ctx;
+     int i;
+     SV* bad_key;
+
+     Zero(&top, 1, ppt_topn);
+     top.k = n > 0 ? n : 0;
+     Newxz(top.heap, top.k + 1, ppt_rec*);
+     top.keys = ppt_keys_new(by, &top.nkeys, 1);
+
+     /* Only the winners survive the scan */
+     Zero(&ctx, 1, ppt_ctx);
+     ctx.collect = collect_topn;
+     ctx.data = &top;
+     if (top.k > 0)
+       ppt_scan(&ctx, -1, NULL, 0);
+
+     RETVAL = NULL;
+     if (top.bad_key == NULL)
+       RETVAL = newRV_noinc((SV*) topn_harvest(&top, ctx.ttydevs));
+
+     for (i = 0; i < top.n; i++)
+       ppt_rec_free(top.heap[i]);
+     Safefree(top.heap);
+     bad_key = top.bad_key ? sv_2mortal(newSVpv(top.bad_key, 0)) : NULL;
+     ppt_keys_free(top.keys, top.nkeys);
+
+     if (bad_key)
+       croak("Can't sort by unknown field `%s'", SvPV_nolen(bad_key));
+
+     OUTPUT:
+     RETVAL
+
+SV*
+_aggregate(obj, by, sum, min, max, count)
+     SV*  obj
+     AV*  by
+     AV*  sum
+     AV*  min
+     AV*  max
+     int  count
+     CODE:
+
+     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
+         croak("Must call aggregate from an initalized object created with new");
+     }
+
+     ppt_aggr aggr;
+     ppt_ctx ctx;
+     SV* bad_key;
+
+     Zero(&aggr, 1, ppt_aggr);
+     aggr.by = ppt_keys_new(by, &aggr.nby, 0);
+     aggr.sum = ppt_keys_new(sum, &aggr.nsum, 0);
+     aggr.min = ppt_keys_new(min, &aggr.nmin, 0);
+     aggr.max = ppt_keys_new(max, &aggr.nmax, 0);
+     aggr_grow(&aggr);
+
+     Zero(&ctx, 1, ppt_ctx);
+     ctx.collect = collect_aggr;
+     ctx.data = &aggr;
+     ppt_scan(&ctx, -1, NULL, 0);
+
+     RETVAL = NULL;
+     bad_key = aggr.bad_key ? sv_2mortal(newSVpv(aggr.bad_key, 0)) : NULL;
+     if (bad_key == NULL)
+       RETVAL = newRV_noinc((SV*) aggr_harvest(&aggr, count));
+     aggr_free(&aggr);
+
+     if (bad_key)
+       croak("Can't aggregate unknown field `%s'", SvPV_nolen(bad_key));
+
+     OUTPUT:
+     RETVAL
+
+SV*
+by_pid(obj, pid)
+     SV*  obj
+     IV   pid
+     CODE:
+
+     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
+         croak("Must call by_pid from an initalized object created with new");
+     }
+
+     ppt_snap* snap;
+     SV** fetched;
+     SV** proc;
+     AV* table;
+     int i;
+
+     /* Look up in the last table, and read one if there is none yet */
+     snap = snap_get(obj);
+
+     RETVAL = &PL_sv_undef;
+     if( snap && snap->packed ){
+       if( (i = snap_find(snap, pid)) >= 0 )
+         RETVAL = snap_view(*hv_fetch((HV*) SvRV(obj), "Snapshot", 8, 0), i);
+       ST(0) = sv_2mortal(RETVAL);
+       XSRETURN(1);
+     }
+     fetched = hv_fetch((HV*) SvRV(obj), "Table", 5, 0);
+     if( snap && fetched && SvROK(*fetched) && SvTYPE(SvRV(*fetched)) == SVt_PVAV ){
+       table = (AV*) SvRV(*fetched);
+       /* the pid check guards against callers that modified the array */
+       if( (i = snap_find(snap, pid)) >= 0 &&
+           (proc = av_fetch(table, i, 0)) != NULL &&
+           SvROK(*proc) && SvTYPE(SvRV(*proc)) == SVt_PVHV &&
+           (fetched = hv_fetch((HV*) SvRV(*proc), "pid", 3, 0)) != NULL &&
+           SvIV(*fetched) == pid ){
+         RETVAL = newSVsv(*proc);
+       }
+     }
+
+     OUTPUT:
+     RETVAL
+
+void
+children(obj, pid)
+     SV*  obj
+     IV   pid
+     ALIAS:
+       descendants = 1
+       ancestors = 2
+     PPCODE:
+
+     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
+         croak("Must call %s from an initalized object created with new", GvNAME(CvGV(cv)));
+     }
+
+     ppt_snap* snap;
+     int* queue;
+     int i, k, tail;
+
+     /* snap_get may call back into perl */
+     snap = snap_get(obj);
+     SPAGAIN;
+     SP -= items;
+     if( snap == NULL || (i = snap_find(snap, pid)) < 0 )
+       XSRETURN_EMPTY;
+
+     switch(ix)
+       {
+       case 0: /* children */
+         EXTEND(SP, snap->kids_at[i + 1] - snap->kids_at[i]);
+         for( k = snap->kids_at[i]; k < snap->kids_at[i + 1]; k++ )
+           PUSHs(sv_2mortal(newSViv(snap->pid[snap->kids[k]])));
+         break;
+
+       case 1: /* descendants, parents before their children */
+         Newx(queue, snap->n, int);
+         tail = snap_subtree(snap, i, queue);
+         EXTEND(SP, tail - 1);
+         for( k = 1; k < tail; k++ )
+           PUSHs(sv_2mortal(newSViv(snap->pid[queue[k]])));
+         Safefree(queue);
+         break;
+
+       case 2: /* ancestors, parent first; the bound guards against loops */
+         for( k = 0; (i = snap->parent[i]) >= 0 && k < snap->n; k++ )
+           XPUSHs(sv_2mortal(newSViv(snap->pid[i])));
+         break;
+       }
+
+void
+rollup(obj, ...)
+     SV*  obj
+     PPCODE:
+
+     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
+         croak("Must call rollup from an initalized object created with new");
+     }
+
+     ppt_snap* snap;
+     SV** fetched;
+     SV** proc;
+     AV* table = NULL;
+     int* order;
+     int* roots;
+     int nroots, norder, i, j, k, r;
+     char key[32];
+
+     /* snap_get may call back into perl */
+     snap = snap_get(obj);
+     SPAGAIN;
+     SP -= items;
+     if( snap == NULL || snap->n == 0 )
+       XSRETURN_EMPTY;
+     if( !snap->packed ){
+       fetched = hv_fetch((HV*) SvRV(obj), "Table", 5, 0);
+       if( !fetched || !SvROK(*fetched) || SvTYPE(SvRV(*fetched)) != SVt_PVAV )
+         XSRETURN_EMPTY;
+       table = (AV*) SvRV(*fetched);
+     }
+
+     Newx(order, snap->n, int);
+     Newx(roots, snap->n, int);
+
+     /* the given pids, or every process without a parent in the table */
+     nroots = 0;
+     if( items > 1 ){
+       for( k = 1; k < items && nroots < snap->n; k++ ){
+         if( (i = snap_find(snap, SvIV(ST(k)))) >= 0 )
+           roots[nroots++] = i;
+       }
+     }
+     else{
+       for( i = 0; i < snap->n; i++ ){
+         if( snap->parent[i] < 0 )
+           roots[nroots++] = i;
+       }
+     }
+
+     for( r = 0; r < nroots; r++ ){
+       norder = snap_subtree(snap, roots[r], order);
+       snap_rollup(snap, order, norder);
+
+       /* views read the totals from the snapshot */
+       if( snap->packed ){
+         XPUSHs(sv_2mortal(snap_view(*hv_fetch((HV*) SvRV(obj), "Snapshot", 8, 0), roots[r])));
+         continue;
+       }
+
+       /* store the totals on the objects of the subtree */
+       for( k = 0; k < norder; k++ ){
+         i = order[k];
+         if( (proc = av_fetch(table, i, 0)) == NULL || !SvROK(*proc) ||
+             SvTYPE(SvRV(*proc)) != SVt_PVHV )
+           continue;
+         for( j = 0; j < NROLL; j++ ){
+           if( snap->f_roll[j] < 0 )
+             continue;
+           my_snprintf(key, sizeof(key), "tree_%s", roll_fields[j]);
+           hv_store((HV*) SvRV(*proc), key, strlen(key), newSVnv(snap->tree[j][i]), 0);
+         }
+         hv_store((HV*) SvRV(*proc), "tree_count", 10, newSViv(snap->tree_count[i]), 0);
+         if( k == 0 )
+           XPUSHs(sv_2mortal(newSVsv(*proc)));
+       }
+     }
+
+     Safefree(order);
+     Safefree(roots);
+
+void
+fields(obj)
+     SV*  obj
+     PPCODE:
+
+     /* see above.  This should be called on an object generated by new */
+     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
+         croak("Must call fields from an initalized object created with new");
+     }
+
+     int i;
+     SV* my_sv;
+
+     fields_need(obj);
+     SPAGAIN;
+     SP -= items;
+     if( Fields == NULL )
+       XSRETURN_EMPTY;
+
+     EXTEND(SP,Numfields);
+     for (i=0; i < Numfields; i++ ){
+       my_sv = newSVpv(Fields[i],0);
+       PUSHs(sv_2mortal(my_sv));
+     }
+
+void
+schema(obj)
+     SV*  obj
+     PPCODE:
+
+     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
+         croak("Must call schema from an initalized object created with new");
+     }
+
+     HV* field;
+     int i;
+
+     fields_need(obj);
+     SPAGAIN;
+     SP -= items;
+     if( Fields == NULL )
+       XSRETURN_EMPTY;
+
+     EXTEND(SP,Numfields);
+     for (i=0; i < Numfields; i++ ){
+       field = newHV();
+       hv_store(field, "name", 4, newSVpv(Fields[i], 0), 0);
+       hv_store(field, "type", 4, newSVpv(field_type(Format ? Format[i] : 'v'), 0), 0);
+       hv_store(field, "unit", 4,
+                Units && Units[i] ? newSVpv(Units[i], 0) : newSV(0), 0);
+       PUSHs(sv_2mortal(newRV_noinc((SV*) field)));
+     }
+
+void
+_delta(obj, names, limits)
+     SV*  obj
+     AV*  names
+     AV*  limits
+     PPCODE:
+
+     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
+         croak("Must call delta from an initalized object created with new");
+     }
+
+     HV* hash = (HV*) SvRV(obj);
+     SV** fetched;
+     SV* snap_sv;
+     SV* prev_sv = NULL;
+     ppt_snap* prev = NULL;
+     ppt_ctx ctx;
+     AV* appeared = newAV();
+     AV* exited = newAV();
+     AV* changed = newAV();
+     int* idx;
+     NV* lim;
+     int n, i, j, k;
+
+     sv_2mortal((SV*) appeared);
+     sv_2mortal((SV*) exited);
+     sv_2mortal((SV*) changed);
+
+     /* resolve the fields before there is anything to clean up */
+     fields_need(obj);
+     SPAGAIN;
+     SP -= items;
+     n = av_len(names) + 1;
+     Newx(idx, n + 1, int);
+     SAVEFREEPV(idx);
+     Newx(lim, n + 1, NV);
+     SAVEFREEPV(lim);
+     for( k = 0; k < n; k++ ){
+       char* name = SvPV_nolen(*av_fetch(names, k, 1));
+
+       for( j = 0; j < Numfields && strcmp(Fields[j], name); j++ )
+         ;
+       if( j == Numfields )
+         croak("Can't compare unknown field `%s'", name);
+       idx[k] = j;
+       fetched = av_fetch(limits, k, 0);
+       lim[k] = fetched ? SvNV(*fetched) : 0;
+     }
+
+     /* the snapshot of the last call */
+     fetched = hv_fetch(hash, "Delta", 5, 0);
+     if( fetched && sv_isa(*fetched, "Proc::ProcessTable::Snapshot") ){
+       prev_sv = sv_2mortal(newSVsv(*fetched));
+       prev = INT2PTR(ppt_snap*, SvIV(SvRV(prev_sv)));
+     }
+
+     /* a packed scan that becomes the snapshot of the next call */
+     Zero(&ctx, 1, ppt_ctx);
+     ctx.snap = snap_new(1);
+     snap_sv = sv_setref_pv(newSV(0), "Proc::ProcessTable::Snapshot", ctx.snap);
+     hv_store(hash, "Delta", 5, snap_sv, 0);
+     ctx.collect = collect_packed;
+     ppt_scan(&ctx, -1, NULL, 0);
+     snap_finish(ctx.snap);
+
+     for( i = 0; i < ctx.snap->n; i++ ){
+       if( prev == NULL || (j = snap_match(prev, ctx.snap, i)) < 0 )
+         av_push(appeared, snap_view(snap_sv, i));
+       else if( ppt_rec_changed(ctx.snap->recs[i], prev->recs[j], idx, lim, n) )
+         av_push(changed, snap_view(snap_sv, i));
+     }
+     /* views of exited processes keep the old snapshot alive */
+     for( j = 0; prev != NULL && j < prev->n; j++ ){
+       if( snap_match(ctx.snap, prev, j) < 0 )
+         av_push(exited, snap_view(prev_sv, j));
+     }
+
+     EXTEND(SP, 3);
+     PUSHs(sv_2mortal(newRV_inc((SV*) appeared)));
+     PUSHs(sv_2mortal(newRV_inc((SV*) exited)));
+     PUSHs(sv_2mortal(newRV_inc((SV*) changed)));
+
+SV*
+rates(obj)
+     SV*  obj
+     CODE:
+
+     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
+         croak("Must call rates from an initalized object created with new");
+     }
+
+     HV* hash = (HV*) SvRV(obj);
+     HV* result = newHV();
+     HV* proc;
+     SV** fetched;
+     ppt_rates* prev = NULL;
+     ppt_rates* cur;
+     ppt_ctx ctx;
+     NV dt, d;
+     int i, j, k;
+     char key[32];
+
+     fetched = hv_fetch(hash, "Rates", 5, 0);
+     if( fetched && sv_isa(*fetched, "Proc::ProcessTable::Rates") )
+       prev = INT2PTR(ppt_rates*, SvIV(SvRV(*fetched)));
+
+     Newxz(cur, 1, ppt_rates);
+     Zero(&ctx, 1, ppt_ctx);
+     ctx.collect = collect_rates;
+     ctx.data = cur;
+     cur->when = monotonic_now();
+     ppt_scan(&ctx, -1, NULL, 0);
+     rates_finish(cur);
+
+     /* processes that were in the last scan as well */
+     dt = prev ? cur->when - prev->when : 0;
+     for( i = 0; dt > 0 && i < cur->n; i++ ){
+       if( (j = rates_find(prev, cur->pid[i], cur->start[i])) < 0 )
+         continue;
+       proc = newHV();
+       for( k = 0; k < NRATE; k++ ){
+         if( cur->vals[k][i] < 0 || prev->vals[k][j] < 0 )
+           continue;
+         d = (cur->vals[k][i] - prev->vals[k][j]) / dt;
+         if( k < 3 )
+           d = d / 1e4;        /* microseconds per second to percent */
+         hv_store(proc, rate_keys[k], strlen(rate_keys[k]), newSVnv(d), 0);
+       }
+       my_snprintf(key, sizeof(key), "%" IVdf, cur->pid[i]);
+       hv_store(result, key, strlen(key), newRV_noinc((SV*) proc), 0);
+     }
+
+     /* the old table goes with the old object */
+     hv_store(hash, "Rates", 5, sv_setref_pv(newSV(0), "Proc::ProcessTable::Rates", cur), 0);
+
+     RETVAL = newRV_noinc((SV*) result);
+     OUTPUT:
+     RETVAL
+
+#if defined(PROCESSTABLE_SAMPLER) && defined(PROCESSTABLE_GET_PROC)
+
+SV*
+_profile_start(obj, pid, hz, size)
+     SV*  obj
+     long pid
+     int  hz
+     UV   size
+     CODE:
+
+     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
+         croak("Must call profile from an initalized object created with new");
+     }
+
+     ppt_profile* p;
+
+     /* the thread can't ask perl for the fields */
+     fields_need(obj);
+     if( (p = profile_start(pid, hz, size)) == NULL )
+       croak("Can't start the profiler thread: %s", Strerror(errno));
+     RETVAL = sv_setref_pv(newSV(0), "Proc::ProcessTable::Profile", p);
+     OUTPUT:
+     RETVAL
+
+#endif
+
+#ifdef	PROCESSTABLE_PROC_EVENTS
+
+SV*
+_events_open(obj, live)
+     SV*  obj
+     int  live
+     CODE:
+
+     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
+         croak("Must call events from an initalized object created with new");
+     }
+
+     ppt_events* ev;
+     int fd;
+
+     if( (fd = events_open()) < 0 )
+       croak("Can't subscribe to process events: %s", Strerror(errno));
+     Newxz(ev, 1, ppt_events);
+     ev->fd = fd;
+     ev->owner = getpid();
+     RETVAL = sv_setref_pv(newSV(0), "Proc::ProcessTable::Events", ev);
+
+     /* the table is read after subscribing, so nothing is missed */
+     if( live ){
+       ev->procs = newHV();
+       events_read_proc(ev, -1);
+     }
+     OUTPUT:
+     RETVAL
+
+#endif
+
+#ifdef	PROCESSTABLE_TASKSTATS
+
+SV*
+_exits_open(obj, by)
+     SV*  obj
+     int  by
+     CODE:
+
+     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
+         croak("Must call exits from an initalized object created with new");
+     }
+
+     ppt_exits* ex;
+
+     if( (ex = exits_open(by)) == NULL )
+       croak("Can't register for exit accounting: %s", Strerror(errno));
+     RETVAL = sv_setref_pv(newSV(0), "Proc::ProcessTable::Exits", ex);
+     OUTPUT:
+     RETVAL
+
+#endif
+
+#ifdef	PROCESSTABLE_PIDFD
+
+void
+_wait_exit(obj, pids, all, timeout, poll)
+     SV*  obj
+     AV*  pids
+     int  all
+     long timeout
+     long poll
+     PPCODE:
+     pid_t* list;
+     char* gone;
+     int n, i;
+
+     n = av_len(pids) + 1;
+     Newx(list, n ? n : 1, pid_t);
+     SAVEFREEPV(list);
+     Newx(gone, n ? n : 1, char);
+     SAVEFREEPV(gone);
+     for( i = 0; i < n; i++ )
+       list[i] = SvIV(*av_fetch(pids, i, 1));
+
+     pids_wait(aTHX_ list, gone, n, all, timeout, poll > 0 ? poll : 1);
+     for( i = 0; i < n; i++ ){
+       if( gone[i] )
+         XPUSHs(sv_2mortal(newSViv(list[i])));
+     }
+
+#endif
+
+void
+_killall(obj, sig, pat, self)
+     SV*  obj
+     int  sig
+     SV*  pat
+     int  self
+     PPCODE:
+     ppt_killall k;
+     ppt_ctx ctx;
+     int nkilled = 0, err = 0, i;
+
+     Zero(&k, 1, ppt_killall);
+     if( (k.rx = SvRX(pat)) == NULL )
+       croak("killall: the pattern must be a qr// regex");
+     k.str = sv_newmortal();
+     k.self = self ? -1 : getpid();
+     k.f_pid = -1;
+
+     Zero(&ctx, 1, ppt_ctx);
+     ctx.collect = collect_killall;
+     ctx.data = &k;
+     ppt_scan(&ctx, -1, killall_names, 4);
+
+     for( i = 0; i < k.n; i++ ){
+       if( killall_signal(k.pids[i], k.starts[i], sig) )
+         nkilled++;
+       else
+         err = errno;
+     }
+     Safefree(k.pids);
+     Safefree(k.starts);
+
+     XPUSHs(sv_2mortal(newSViv(nkilled)));
+     XPUSHs(sv_2mortal(newSViv(err)));
+
+void
+_killfam(obj, sig, roots, freeze)
+     SV*  obj
+     int  sig
+     AV*  roots
+     int  freeze
+     PPCODE:
+     ppt_family f;
+     IV pid;
+     int nkilled = 0, err = 0, i, k;
+
+     Zero(&f, 1, ppt_family);
+     family_scan(&f);
+     for( i = 0; i <= av_len(roots); i++ ){
+       pid = SvIV(*av_fetch(roots, i, 1));
+       if( (k = snap_find(f.snap, pid)) >= 0 )
+         family_add_tree(&f, k);
+       else if( !family_has(&f, pid) )
+         family_add(&f, pid, -1);
+     }
+
+     /* the caller may be in the family, but must not stop */
+     if( freeze && sig != SIGSTOP ){
+       for( i = 0; i < f.n; i++ )
+         if( f.pids[i] != getpid() )
+           family_signal(&f, i, SIGSTOP);
+       family_freeze(&f);
+     }
+     for( i = 0; i < f.n; i++ ){
+       if( family_signal(&f, i, sig) )
+         nkilled++;
+       else
+         err = errno;
+     }
+     if( freeze && sig != SIGSTOP && sig != SIGKILL )
+       for( i = 0; i < f.n; i++ )
+         family_signal(&f, i, SIGCONT);
+     family_free(&f);
+
+     XPUSHs(sv_2mortal(newSViv(nkilled)));
+     XPUSHs(sv_2mortal(newSViv(err)));
+
+SV*
+_apply(obj, names, alts, nice, ioprio, affinity, sig)
+     SV*  obj
+     AV*  names
+     AV*  alts
+     SV*  nice
+     int  ioprio
+     SV*  affinity
+     SV*  sig
+     CODE:
+     ppt_apply a;
+     ppt_apply_ops ops;
+     ppt_ctx ctx;
+     char** fields;
+     HV* result;
+     SV* bad_key;
+     int i;
+
+     Zero(&ops, 1, ppt_apply_ops);
+     ops.set_nice = SvOK(nice);
+     ops.nice = ops.set_nice ? SvIV(nice) : 0;
+     ops.ioprio = ioprio;
+     ops.ncpus = -1;
+     if( SvROK(affinity) && SvTYPE(SvRV(affinity)) == SVt_PVAV ){
+       AV* cpus = (AV*) SvRV(affinity);
+
+       ops.ncpus = av_len(cpus) + 1;
+       Newx(ops.cpus, ops.ncpus ? ops.ncpus : 1, int);
+       SAVEFREEPV(ops.cpus);
+       for( i = 0; i < ops.ncpus; i++ )
+         ops.cpus[i] = SvIV(*av_fetch(cpus, i, 1));
+     }
+     ops.set_sig = SvOK(sig);
+     ops.sig = ops.set_sig ? SvIV(sig) : 0;
+
+     Zero(&a, 1, ppt_apply);
+     a.keys = ppt_keys_new(names, &a.nkeys, 0);
+     Newx(a.alts, a.nkeys ? a.nkeys : 1, AV*);
+     SAVEFREEPV(a.alts);
+     for( i = 0; i < a.nkeys; i++ )
+       a.alts[i] = (AV*) SvRV(*av_fetch(alts, i, 1));
+     a.str = sv_newmortal();
+     a.self = getpid();
+
+     /* just the fields of where, and pid and start */
+     Newx(fields, a.nkeys + 2, char*);
+     SAVEFREEPV(fields);
+     for( i = 0; i < a.nkeys; i++ )
+       fields[i] = a.keys[i].name;
+     fields[a.nkeys] = "pid";
+     fields[a.nkeys + 1] = "start";
+
+     Zero(&ctx, 1, ppt_ctx);
+     ctx.collect = collect_apply;
+     ctx.data = &a;
+     ppt_scan(&ctx, -1, fields, a.nkeys + 2);
+
+     bad_key = a.bad_key ? sv_2mortal(newSVpv(a.bad_key, 0)) : NULL;
+     ppt_keys_free(a.keys, a.nkeys);
+     if( bad_key ){
+       Safefree(a.pids);
+       Safefree(a.starts);
+       croak("apply: unknown field `%s' in where", SvPV_nolen(bad_key));
+     }
+
+     result = newHV();
+     RETVAL = newRV_noinc((SV*) result);
+     for( i = 0; i < a.n; i++ )
+       hv_store_ent(result, sv_2mortal(newSViv(a.pids[i])),
+                    newSViv(apply_ops(a.pids[i], a.starts[i], &ops)), 0);
+     Safefree(a.pids);
+     Safefree(a.starts);
+
+     OUTPUT:
+     RETVAL
 
 void 
 _initialize_os(obj)
@@ -421,3 +4666,683 @@ _initialize_os(obj)
      if( (error = OS_initialize()) != NULL ){
        croak("%s", error);
      }
+
+#ifdef	PROCESSTABLE_SAMPLER
+
+int
+_sampler_start(obj, interval, notify)
+     SV*  obj
+     long interval
+     int  notify
+     CODE:
+
+     if (!obj || !SvOK (obj) || !SvROK (obj) || !sv_isobject (obj)) {
+         croak("Must call start_sampler from an initalized object created with new");
+     }
+
+     ppt_sampler* s;
+
+     /* the thread can't ask perl for the fields */
+     fields_need(obj);
+     if( (s = sampler_start(interval, notify)) == NULL )
+       croak("Can't start the sampler thread: %s", Strerror(errno));
+     hv_store((HV*) SvRV(obj), "Sampler", 7,
+              sv_setref_pv(newSV(0), "Proc::ProcessTable::Sampler", s), 0);
+     RETVAL = s->notify;
+     OUTPUT:
+     RETVAL
+
+SV*
+_sampler_latest(obj, fresh)
+     SV*  obj
+     int  fresh
+     CODE:
+     SV** fetched;
+     ppt_snap* snap;
+     SV* snap_sv;
+
+     fetched = hv_fetch((HV*) SvRV(obj), "Sampler", 7, 0);
+     if( fetched == NULL || !sv_isa(*fetched, "Proc::ProcessTable::Sampler") )
+       croak("No sampler running, call start_sampler first");
+
+     RETVAL = &PL_sv_undef;
+     snap = sampler_latest(INT2PTR(ppt_sampler*, SvIV(SvRV(*fetched))), fresh);
+     if( snap != NULL ){
+       /* like table(packed => 1), but somebody else did the scan */
+       hv_delete((HV*) SvRV(obj), "Table", 5, G_DISCARD);
+       snap_sv = sv_setref_pv(newSV(0), "Proc::ProcessTable::Snapshot", snap);
+       hv_store((HV*) SvRV(obj), "Snapshot", 8, snap_sv, 0);
+       RETVAL = newSVsv(snap_sv);
+     }
+     OUTPUT:
+     RETVAL
+
+#endif
+
+MODULE = Proc::ProcessTable		PACKAGE = Proc::ProcessTable::Process
+
+void
+_install_accessor(name)
+     char* name
+     CODE:
+     if( accessor_known(name) )
+       install_accessor(name);
+
+SV*
+argv(self, i)
+     SV*  self
+     SV*  i
+     ALIAS:
+       env = 1
+     CODE:
+     HE* he;
+
+     if( !SvROK(self) || SvTYPE(SvRV(self)) != SVt_PVHV )
+       croak("%s is not an object", SvPV_nolen(self));
+     he = hv_fetch_ent((HV*) SvRV(self), sv_2mortal(newSVpv(ix ? "environ" : "cmdline", 0)), 0, 0);
+     RETVAL = he ? lazy_array_lookup(HeVAL(he), i, ix) : &PL_sv_undef;
+     OUTPUT:
+     RETVAL
+
+int
+refresh(self, ...)
+     SV*  self
+     CODE:
+     HV* hash;
+     SV** fetched;
+     AV* av = NULL;
+     ppt_ctx ctx;
+     ppt_rec* rec;
+     char** names = NULL;
+     char* want = NULL;
+     char* opt;
+     int nnames = 0;
+     NV nv;
+     int i, j, f;
+
+     if( !SvROK(self) || SvTYPE(SvRV(self)) != SVt_PVHV )
+       croak("%s is not an object", SvPV_nolen(self));
+     hash = (HV*) SvRV(self);
+
+     if( items % 2 == 0 )
+       croak("Odd number of options passed to refresh");
+     for( i = 1; i < items; i += 2 ){
+       opt = SvPV_nolen(ST(i));
+       if( !strcmp(opt, "fields") ){
+         if( !SvROK(ST(i + 1)) || SvTYPE(SvRV(ST(i + 1))) != SVt_PVAV )
+           croak("fields must be an array reference");
+         av = (AV*) SvRV(ST(i + 1));
+       }
+       else
+         croak("Unknown option `%s' passed to refresh", opt);
+     }
+
+     RETVAL = 0;
+     if( (fetched = hv_fetch(hash, "pid", 3, 0)) == NULL || !SvOK(*fetched) )
+       XSRETURN_NO;
+
+     if( av != NULL ){
+       nnames = av_len(av) + 1;
+       Newx(names, nnames + 1, char*);
+       for( i = 0; i < nnames; i++ ){
+         SV** name = av_fetch(av, i, 0);
+         names[i] = name ? SvPV_nolen(*name) : "";
+       }
+       /* ttydev comes from ttynum */
+       names[nnames] = "ttynum";
+       SAVEFREEPV(names);
+     }
+
+     rec = ppt_rec_read(&ctx, SvIV(*fetched), names, names ? nnames + 1 : 0);
+     if( rec != NULL ){
+       /* a different process if the start time changed */
+       f = ppt_rec_field(rec, "start");
+       if( f < 0 || !ppt_val_num(&rec->vals[f], &nv) ||
+           (fetched = hv_fetch(hash, "start", 5, 0)) == NULL || !SvOK(*fetched) ||
+           SvNV(*fetched) == nv ){
+         if( names != NULL ){
+           Newxz(want, rec->nvals, char);
+           SAVEFREEPV(want);
+           for( i = 0; i < rec->nvals; i++ )
+             for( j = 0; j < nnames; j++ )
+               if( !strcmp(rec->fields[i], names[j]) ||
+                   (!strcmp(rec->fields[i], "ttynum") && !strcmp(names[j], "ttydev")) )
+                 want[i] = 1;
+         }
+         ppt_rec_update(ctx.ttydevs, hash, rec, 0, want);
+         RETVAL = 1;
+       }
+       ppt_rec_free(rec);
+     }
+     OUTPUT:
+     RETVAL
+
+#ifdef	PROCESSTABLE_PIDFD
+
+SV*
+handle(self)
+     SV*  self
+     CODE:
+     if( !SvROK(self) || SvTYPE(SvRV(self)) != SVt_PVHV )
+       croak("%s is not an object", SvPV_nolen(self));
+     RETVAL = SvREFCNT_inc(process_handle((HV*) SvRV(self)));
+     OUTPUT:
+     RETVAL
+
+#endif
+
+MODULE = Proc::ProcessTable		PACKAGE = Proc::ProcessTable::Process::View
+
+SV*
+argv(self, i)
+     SV*  self
+     SV*  i
+     ALIAS:
+       env = 1
+     CODE:
+     ppt_snap* snap;
+     ppt_rec* rec;
+     SV** snap_sv;
+     SV** i_sv;
+     STRLEN namelen;
+     const char* name;
+     int idx, n;
+
+     if( !SvROK(self) || SvTYPE(SvRV(self)) != SVt_PVAV ||
+         (snap_sv = av_fetch((AV*) SvRV(self), 0, 0)) == NULL ||
+         (i_sv = av_fetch((AV*) SvRV(self), 1, 0)) == NULL )
+       croak("%s is not a process view", SvPV_nolen(self));
+     snap = snap_from_sv(*snap_sv);
+     n = SvIV(*i_sv);
+     if( !snap->packed || n < 0 || n >= snap->n )
+       croak("Invalid process view");
+     rec = snap->recs[n];
+
+     RETVAL = NULL;
+     if( (idx = ppt_rec_field(rec, ix ? "environ" : "cmdline")) >= 0 && rec->vals[idx].fmt == 'a' ){
+       if( ix ){
+         name = SvPV(i, namelen);
+         RETVAL = nul_list_env(rec->vals[idx].u.str.pv, rec->vals[idx].u.str.len, name, namelen);
+       }
+       else{
+         RETVAL = nul_list_nth(rec->vals[idx].u.str.pv, rec->vals[idx].u.str.len, SvIV(i));
+       }
+     }
+     if( RETVAL == NULL )
+       RETVAL = &PL_sv_undef;
+     OUTPUT:
+     RETVAL
+
+MODULE = Proc::ProcessTable		PACKAGE = Proc::ProcessTable::Snapshot
+
+int
+count(snap_sv)
+     SV*  snap_sv
+     CODE:
+     RETVAL = snap_from_sv(snap_sv)->n;
+     OUTPUT:
+     RETVAL
+
+SV*
+process(snap_sv, i)
+     SV*  snap_sv
+     int  i
+     CODE:
+     ppt_snap* snap = snap_from_sv(snap_sv);
+
+     if( !snap->packed )
+       croak("Only packed tables have process views");
+     if( i < 0 )
+       i += snap->n;
+     RETVAL = i >= 0 && i < snap->n ? snap_view(snap_sv, i) : &PL_sv_undef;
+     OUTPUT:
+     RETVAL
+
+SV*
+by_pid(snap_sv, pid)
+     SV*  snap_sv
+     IV   pid
+     CODE:
+     ppt_snap* snap = snap_from_sv(snap_sv);
+     int i;
+
+     if( !snap->packed )
+       croak("Only packed tables have process views");
+     RETVAL = (i = snap_find(snap, pid)) >= 0 ? snap_view(snap_sv, i) : &PL_sv_undef;
+     OUTPUT:
+     RETVAL
+
+SV*
+_field(snap_sv, i, name)
+     SV*  snap_sv
+     int  i
+     char* name
+     CODE:
+     ppt_snap* snap = snap_from_sv(snap_sv);
+
+     if( !snap->packed || i < 0 || i >= snap->n )
+       croak("Invalid process view");
+     if( (RETVAL = snap_field(snap, i, name)) == NULL )
+       croak("Can't access `%s' field in class Proc::ProcessTable::Process::View", name);
+     OUTPUT:
+     RETVAL
+
+SV*
+_bless(snap_sv, i)
+     SV*  snap_sv
+     int  i
+     CODE:
+     ppt_snap* snap = snap_from_sv(snap_sv);
+     HV* hash;
+     SV* val;
+     int j;
+     char key[32];
+
+     if( !snap->packed || i < 0 || i >= snap->n )
+       croak("Invalid process view");
+     RETVAL = ppt_rec_bless(perl_get_hv("Proc::ProcessTable::TTYDEVS", FALSE),
+                            snap->recs[i]);
+
+     /* rollup() totals live in the snapshot */
+     if( snap->rolled && snap->tree_count[i] ){
+       hash = (HV*) SvRV(RETVAL);
+       for( j = 0; j < NROLL; j++ ){
+         my_snprintf(key, sizeof(key), "tree_%s", roll_fields[j]);
+         if( (val = snap_field(snap, i, key)) != NULL )
+           hv_store(hash, key, strlen(key), val, 0);
+       }
+       hv_store(hash, "tree_count", 10, newSViv(snap->tree_count[i]), 0);
+     }
+     OUTPUT:
+     RETVAL
+
+void
+DESTROY(snap_sv)
+     SV*  snap_sv
+     CODE:
+     snap_release(INT2PTR(ppt_snap*, SvIV(SvRV(snap_sv))));
+
+#ifdef	PROCESSTABLE_PIDFD
+
+MODULE = Proc::ProcessTable		PACKAGE = Proc::ProcessTable::Handle
+
+int
+fd(self)
+     SV*  self
+     ALIAS:
+       pid = 1
+       alive = 2
+     CODE:
+     ppt_handle* h = INT2PTR(ppt_handle*, SvIV(SvRV(self)));
+
+     RETVAL = ix == 0 ? h->fd : ix == 1 ? h->pid : handle_alive(h);
+     OUTPUT:
+     RETVAL
+
+int
+_signal(self, sig)
+     SV*  self
+     int  sig
+     CODE:
+     ppt_handle* h = INT2PTR(ppt_handle*, SvIV(SvRV(self)));
+
+     RETVAL = handle_signal(h, sig) == 0;
+     OUTPUT:
+     RETVAL
+
+void
+DESTROY(self)
+     SV*  self
+     CODE:
+     handle_free(INT2PTR(ppt_handle*, SvIV(SvRV(self))));
+
+#endif
+
+MODULE = Proc::ProcessTable		PACKAGE = Proc::ProcessTable::Rates
+
+void
+DESTROY(rates_sv)
+     SV*  rates_sv
+     CODE:
+     rates_free(INT2PTR(ppt_rates*, SvIV(SvRV(rates_sv))));
+
+#ifdef	PROCESSTABLE_TASKSTATS
+
+MODULE = Proc::ProcessTable		PACKAGE = Proc::ProcessTable::Exits
+
+int
+fd(ex_sv)
+     SV*  ex_sv
+     CODE:
+     ppt_exits* ex = INT2PTR(ppt_exits*, SvIV(SvRV(ex_sv)));
+
+     RETVAL = ex->fd;
+     OUTPUT:
+     RETVAL
+
+UV
+lost(ex_sv)
+     SV*  ex_sv
+     CODE:
+     ppt_exits* ex = INT2PTR(ppt_exits*, SvIV(SvRV(ex_sv)));
+
+     RETVAL = ex->lost;
+     OUTPUT:
+     RETVAL
+
+void
+read(ex_sv)
+     SV*  ex_sv
+     PPCODE:
+     ppt_exits* ex = INT2PTR(ppt_exits*, SvIV(SvRV(ex_sv)));
+     struct nlmsghdr* nl;
+     struct nlattr* na;
+     struct nlattr* inner;
+     struct taskstats ts;
+     ssize_t len;
+     int rest, inrest, reads;
+     union {
+       struct nlmsghdr nl;
+       char buf[16384];
+     } msg;
+
+     /* what is there, but don't wait, and come back to the caller
+        now and then on a busy host */
+     for( reads = 0; reads < 1024; reads++ ){
+       len = recv(ex->fd, &msg, sizeof(msg), 0);
+       if( len < 0 ){
+         if( errno == EINTR )
+           continue;
+         if( errno == ENOBUFS ){
+           ex->lost++;
+           continue;
+         }
+         break;
+       }
+       for( nl = &msg.nl; NLMSG_OK(nl, len); nl = NLMSG_NEXT(nl, len) ){
+         if( nl->nlmsg_type != ex->family )
+           continue;
+         /* the stats of each task are in a TASKSTATS_TYPE_AGGR_PID;
+            the TGID ones repeat them for thread groups */
+         na = (struct nlattr*) ((char*) NLMSG_DATA(nl) + GENL_HDRLEN);
+         for( rest = nl->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN); rest >= NLA_HDRLEN; rest -= NLA_ALIGN(na->nla_len), na = EXIT_ATTR_NEXT(na) ){
+           if( na->nla_type != TASKSTATS_TYPE_AGGR_PID )
+             continue;
+           inner = (struct nlattr*) EXIT_ATTR_DATA(na);
+           for( inrest = na->nla_len - NLA_HDRLEN; inrest >= NLA_HDRLEN; inrest -= NLA_ALIGN(inner->nla_len), inner = EXIT_ATTR_NEXT(inner) ){
+             if( inner->nla_type != TASKSTATS_TYPE_STATS )
+               continue;
+             /* the kernel's struct may be older or newer than ours */
+             Zero(&ts, 1, struct taskstats);
+             Copy(EXIT_ATTR_DATA(inner), &ts,
+                  inner->nla_len - NLA_HDRLEN < sizeof(ts) ? inner->nla_len - NLA_HDRLEN : sizeof(ts), char);
+             if( ex->totals != NULL )
+               exits_add(ex, &ts);
+             else
+               XPUSHs(sv_2mortal(newRV_noinc((SV*) exits_record(&ts))));
+           }
+         }
+       }
+     }
+
+SV*
+totals(ex_sv, ...)
+     SV*  ex_sv
+     CODE:
+     ppt_exits* ex = INT2PTR(ppt_exits*, SvIV(SvRV(ex_sv)));
+     ppt_exit_totals* t;
+     HV* result;
+     HV* hash;
+     HE* he;
+     I32 klen;
+     char* key;
+     int reset = 0;
+     int i;
+
+     if( ex->totals == NULL )
+       croak("totals needs an exits object made with by => 'uid' or 'fname'");
+     /* totals(reset => 1) starts over */
+     if( items > 1 ){
+       if( items != 3 || strcmp(SvPV_nolen(ST(1)), "reset") )
+         croak("Unknown option passed to totals");
+       reset = SvTRUE(ST(2));
+     }
+
+     result = newHV();
+     hv_iterinit(ex->totals);
+     while( (he = hv_iternext(ex->totals)) != NULL ){
+       key = hv_iterkey(he, &klen);
+       t = (ppt_exit_totals*) SvPVX(HeVAL(he));
+       hash = newHV();
+       hv_stores(hash, "count", newSVuv(t->count));
+       for( i = 0; i < NEXIT; i++ )
+         hv_store(hash, exit_sums[i], strlen(exit_sums[i]), newSVnv(t->sums[i]), 0);
+       hv_stores(hash, "maxrss", newSVnv(t->maxrss));
+       hv_store(result, key, klen, newRV_noinc((SV*) hash), 0);
+     }
+     if( reset )
+       hv_clear(ex->totals);
+     RETVAL = newRV_noinc((SV*) result);
+     OUTPUT:
+     RETVAL
+
+void
+DESTROY(ex_sv)
+     SV*  ex_sv
+     CODE:
+     exits_free(INT2PTR(ppt_exits*, SvIV(SvRV(ex_sv))));
+
+#endif
+
+#ifdef	PROCESSTABLE_PROC_EVENTS
+
+MODULE = Proc::ProcessTable		PACKAGE = Proc::ProcessTable::Events
+
+int
+fd(ev_sv)
+     SV*  ev_sv
+     CODE:
+     ppt_events* ev = INT2PTR(ppt_events*, SvIV(SvRV(ev_sv)));
+
+     RETVAL = ev->fd;
+     OUTPUT:
+     RETVAL
+
+UV
+lost(ev_sv)
+     SV*  ev_sv
+     CODE:
+     ppt_events* ev = INT2PTR(ppt_events*, SvIV(SvRV(ev_sv)));
+
+     RETVAL = ev->lost;
+     OUTPUT:
+     RETVAL
+
+void
+read(ev_sv)
+     SV*  ev_sv
+     PPCODE:
+     ppt_events* ev = INT2PTR(ppt_events*, SvIV(SvRV(ev_sv)));
+     struct sockaddr_nl from;
+     socklen_t fromlen;
+     struct nlmsghdr* nl;
+     struct cn_msg* cn;
+     HV* hash;
+     ssize_t len;
+     int reads;
+     union {
+       struct nlmsghdr nl;
+       char buf[8192];
+     } msg;
+
+     /* what is there, but don't wait, and come back to the caller
+        now and then on a busy host */
+     for( reads = 0; reads < 1024; reads++ ){
+       fromlen = sizeof(from);
+       len = recvfrom(ev->fd, &msg, sizeof(msg), 0, (struct sockaddr*) &from, &fromlen);
+       if( len < 0 ){
+         if( errno == EINTR )
+           continue;
+         if( errno != ENOBUFS )
+           break;
+         /* the kernel dropped some, so the live table can't be trusted */
+         ev->lost++;
+         if( ev->procs != NULL )
+           events_read_proc(ev, -1);
+         continue;
+       }
+       /* only the kernel may send these */
+       if( from.nl_pid != 0 )
+         continue;
+       for( nl = &msg.nl; NLMSG_OK(nl, len); nl = NLMSG_NEXT(nl, len) ){
+         if( nl->nlmsg_type == NLMSG_ERROR || nl->nlmsg_type == NLMSG_NOOP )
+           continue;
+         cn = (struct cn_msg*) NLMSG_DATA(nl);
+         if( cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC )
+           continue;
+         if( (hash = events_event(ev, (struct proc_event*) cn->data)) != NULL )
+           XPUSHs(sv_2mortal(newRV_noinc((SV*) hash)));
+       }
+     }
+
+SV*
+table(ev_sv)
+     SV*  ev_sv
+     CODE:
+     ppt_events* ev = INT2PTR(ppt_events*, SvIV(SvRV(ev_sv)));
+     AV* procs;
+     HE* he;
+
+     if( ev->procs == NULL )
+       croak("table needs an events object made with live => 1");
+     procs = newAV();
+     av_extend(procs, HvUSEDKEYS(ev->procs));
+     hv_iterinit(ev->procs);
+     while( (he = hv_iternext(ev->procs)) != NULL )
+       av_push(procs, newSVsv(HeVAL(he)));
+     RETVAL = newRV_noinc((SV*) procs);
+     OUTPUT:
+     RETVAL
+
+SV*
+by_pid(ev_sv, pid)
+     SV*  ev_sv
+     IV   pid
+     CODE:
+     ppt_events* ev = INT2PTR(ppt_events*, SvIV(SvRV(ev_sv)));
+     SV** fetched;
+     char key[32];
+
+     if( ev->procs == NULL )
+       croak("by_pid needs an events object made with live => 1");
+     my_snprintf(key, sizeof(key), "%" IVdf, pid);
+     fetched = hv_fetch(ev->procs, key, strlen(key), 0);
+     RETVAL = fetched ? newSVsv(*fetched) : &PL_sv_undef;
+     OUTPUT:
+     RETVAL
+
+void
+DESTROY(ev_sv)
+     SV*  ev_sv
+     CODE:
+     events_free(INT2PTR(ppt_events*, SvIV(SvRV(ev_sv))));
+
+#endif
+
+#if defined(PROCESSTABLE_SAMPLER) && defined(PROCESSTABLE_GET_PROC)
+
+MODULE = Proc::ProcessTable		PACKAGE = Proc::ProcessTable::Profile
+
+SV*
+_drain(prof_sv)
+     SV*  prof_sv
+     CODE:
+     ppt_profile* p = INT2PTR(ppt_profile*, SvIV(SvRV(prof_sv)));
+     ppt_sample* samples;
+     UV n, i, j;
+
+     RETVAL = newSVpvs("");
+     if( !p->header ){
+       sv_catpvs(RETVAL, "tp\ttime\tpids\trss\tvsz\tpcpu\n");
+       p->header = 1;
+     }
+
+     /* take the samples; after an overrun the oldest tick left may
+        have lost some of its samples, so it goes as well */
+     pthread_mutex_lock(&p->t.lock);
+     if( p->head - p->tail > p->size ){
+       p->dropped += p->head - p->size - p->tail;
+       p->tail = p->head - p->size;
+       for( i = p->ring[p->tail % p->size].tick;
+            p->tail < p->head && p->ring[p->tail % p->size].tick == i; p->tail++ )
+         p->dropped++;
+       /* the rate is from the ticks on either side of the gap */
+       p->nlast = 0;
+     }
+     n = p->head - p->tail;
+     Newx(samples, n ? n : 1, ppt_sample);
+     for( i = 0; i < n; i++ )
+       samples[i] = p->ring[(p->tail + i) % p->size];
+     p->tail = p->head;
+     pthread_mutex_unlock(&p->t.lock);
+
+     for( i = 0; i < n; i = j ){
+       for( j = i + 1; j < n && samples[j].tick == samples[i].tick; j++ )
+         ;
+       profile_tick_tsv(aTHX_ p, samples + i, j - i, RETVAL);
+     }
+     Safefree(samples);
+     OUTPUT:
+     RETVAL
+
+int
+running(prof_sv)
+     SV*  prof_sv
+     CODE:
+     ppt_profile* p = INT2PTR(ppt_profile*, SvIV(SvRV(prof_sv)));
+
+     pthread_mutex_lock(&p->t.lock);
+     RETVAL = p->t.running && !p->t.stop && !p->done;
+     pthread_mutex_unlock(&p->t.lock);
+     OUTPUT:
+     RETVAL
+
+UV
+dropped(prof_sv)
+     SV*  prof_sv
+     CODE:
+     ppt_profile* p = INT2PTR(ppt_profile*, SvIV(SvRV(prof_sv)));
+
+     pthread_mutex_lock(&p->t.lock);
+     RETVAL = p->dropped;
+     pthread_mutex_unlock(&p->t.lock);
+     OUTPUT:
+     RETVAL
+
+void
+stop(prof_sv)
+     SV*  prof_sv
+     CODE:
+     ppt_profile* p = INT2PTR(ppt_profile*, SvIV(SvRV(prof_sv)));
+
+     thread_stop(&p->t);
+
+void
+DESTROY(prof_sv)
+     SV*  prof_sv
+     CODE:
+     profile_free(INT2PTR(ppt_profile*, SvIV(SvRV(prof_sv))));
+
+#endif
+
+#ifdef	PROCESSTABLE_SAMPLER
+
+MODULE = Proc::ProcessTable		PACKAGE = Proc::ProcessTable::Sampler
+
+void
+DESTROY(sampler_sv)
+     SV*  sampler_sv
+     CODE:
+     sampler_free(INT2PTR(ppt_sampler*, SvIV(SvRV(sampler_sv))));
+
+#endif
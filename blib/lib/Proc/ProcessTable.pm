@@ -0,0 +1,880 @@
+package Proc::ProcessTable;
+
+use 5.006;
+
+use strict;
+use warnings;
+use Carp;
+use Config;
+use Scalar::Util qw(looks_like_number);
+use vars qw($VERSION @ISA @EXPORT @EXPORT_OK $AUTOLOAD);
+
+require Exporter;
+require DynaLoader;
+
+@ISA = qw(Exporter DynaLoader);
+# Items to export into callers namespace by default. Note: do not export
+# names by default without a very good reason. Use EXPORT_OK instead.
+# Do not simply export all your public functions/methods/constants.
+@EXPORT = qw(
+    
+);
+$VERSION = '0.637';
+
+sub AUTOLOAD {
+    # This AUTOLOAD is used to 'autoload' constants from the constant()
+    # XS function.  If a constant is not found then control is passed
+    # to the AUTOLOAD in AutoLoader.
+
+    my $constname;
+    ($constname = $AUTOLOAD) =~ s/.*:://;
+    my $val = constant($constname, @_ ? $_[0] : 0);
+    if ($! != 0) {
+    if ($! =~ /Invalid/) {
+        $AutoLoader::AUTOLOAD = $AUTOLOAD;
+        goto &AutoLoader::AUTOLOAD;
+    }
+    else {
+        croak "Your vendor has not defined Proc::ProcessTable macro $constname";
+    }
+    }
+    eval "sub $AUTOLOAD { $val }";
+    goto &$AUTOLOAD;
+}
+
+bootstrap Proc::ProcessTable $VERSION;
+
+# Preloaded methods go here.
+use Proc::ProcessTable::Process;
+use Proc::ProcessTable::Snapshot;
+use Proc::ProcessTable::Profile;
+use Proc::ProcessTable::Events;
+use Proc::ProcessTable::Exits;
+use Proc::ProcessTable::Handle;
+use File::Find;
+
+my %TTYDEVS;
+
+our $TTYDEVSFILE = "/tmp/TTYDEVS_" . $Config{byteorder}; # Where we store the TTYDEVS hash
+
+sub new 
+{
+  my ($this, %args) = @_;
+  my $class = ref($this) || $this;
+  my $self = {};
+  bless $self, $class;
+
+  mutex_new(1);
+  if ( exists $args{cache_ttys} && $args{cache_ttys} == 1 )
+  { 
+    $self->{cache_ttys} = 1 
+  }
+
+  if ( exists $args{enable_ttys} && (! $args{enable_ttys}))
+  {
+    $self->{enable_ttys} = 0;
+    if ($self->{'cache_ttys'}) {
+      carp("cache_ttys specified with enable_ttys, cache_ttys a no-op");
+    }
+  }
+  else
+  {
+    $self->{enable_ttys} = 1;
+  }
+
+  my $status = $self->initialize;
+  mutex_new(0);
+  if($status)
+  {
+    return $self; 
+  }
+  else
+  {
+    return undef;
+  }
+}
+
+sub initialize 
+{
+  my ($self) = @_;
+
+  if ($self->{enable_ttys})
+  {
+
+    # Get the mapping of TTYs to device nums
+    # reading/writing the cache if we are caching
+    if( $self->{cache_ttys} )
+    {
+
+      require Storable;
+
+      if( -r $TTYDEVSFILE )
+      {
+        $_ = Storable::retrieve($TTYDEVSFILE);
+        %Proc::ProcessTable::TTYDEVS = %$_;
+      }
+      else
+      {
+        $self->_get_tty_list;
+
+        require File::Temp;
+        require File::Basename;
+
+        my($ttydevs_fh, $ttydevs_tmpfile) = File::Temp::tempfile('ProcessTable_XXXXXXXX', DIR => File::Basename::dirname($TTYDEVSFILE));
+        chmod 0644, $ttydevs_tmpfile;
+        Storable::store_fd( \%Proc::ProcessTable::TTYDEVS, $ttydevs_fh );
+        close $ttydevs_fh;
+
+        if( !rename $ttydevs_tmpfile, $TTYDEVSFILE )
+        {
+          my $err = $!;
+          unlink $ttydevs_tmpfile;
+          if( !-r $TTYDEVSFILE)
+          {
+            die "Renaming $ttydevs_tmpfile to $TTYDEVSFILE failed: $err";
+          }
+          # else somebody else obviously created the file in the meantime
+        }
+      }
+    }
+    else
+    {
+      $self->_get_tty_list;
+    }
+  }
+
+  # Call the os-specific initialization
+  $self->_initialize_os;
+
+  return 1; 
+}
+
+###############################################
+# The number of a signal name or number, negative
+# for process groups as with kill; undef if there
+# is no such signal. Shared by the modules that
+# send signals.
+###############################################
+my %SIGNO;
+
+sub _signo
+{
+  my ($sig) = @_;
+  @SIGNO{ split ' ', $Config{sig_name} } = split ' ', $Config{sig_num}
+    unless %SIGNO;
+
+  my $neg = $sig =~ s/^-// ? -1 : 1;
+  $sig =~ s/^SIG//;
+  my $n = $sig =~ /^\d+$/ ? $sig : $SIGNO{$sig};
+  return defined $n ? $neg * $n : undef;
+}
+
+###############################################
+# Generate a hash mapping TTY numbers to paths.
+# This might be faster in Table.xs,
+# but it's a lot more portable here
+###############################################
+sub _get_tty_list 
+{
+  my ($self) = @_;
+  undef %Proc::ProcessTable::TTYDEVS;
+  return unless -d "/dev";
+  find({ wanted => 
+       sub{
+     $File::Find::prune = 1 if -d $_ && ( ! -x $_ || $_ eq "/dev/.lxc" || $_ eq "/dev/.lxd-mounts");
+     my($dev,$ino,$mode,$nlink,$uid,$gid,$rdev,$size,
+        $atime,$mtime,$ctime,$blksize,$blocks) = stat($File::Find::name);
+     $Proc::ProcessTable::TTYDEVS{$rdev} = $File::Find::name
+       if(-c $File::Find::name);
+       }, no_chdir => 1},
+       "/dev" 
+      );
+}
+
+###############################################
+# Return the n "largest" processes. The selection
+# is done in ProcessTable.xs while the table is
+# read, so only the winners become objects.
+###############################################
+sub top
+{
+  my ($self, %args) = @_;
+
+  my $n = $args{n};
+  croak("top: n must be a positive integer")
+    unless defined $n && $n =~ /^\d+$/ && $n > 0;
+
+  my $by = defined $args{by} ? $args{by} : '-pctcpu';
+  $by = [ $by ] unless ref $by;
+  croak("top: by must be a field name or a list of field names")
+    unless ref $by eq 'ARRAY' && @$by;
+
+  return $self->_top($n, $by);
+}
+
+###############################################
+# Group-by aggregation; the per-group counters
+# are kept in ProcessTable.xs, no process
+# objects are created.
+###############################################
+sub aggregate
+{
+  my ($self, %args) = @_;
+
+  my %lists;
+  foreach my $arg (qw(by sum min max))
+  {
+    my $list = defined $args{$arg} ? $args{$arg} : [];
+    $list = [ $list ] unless ref $list;
+    croak("aggregate: $arg must be a field name or a list of field names")
+      unless ref $list eq 'ARRAY';
+    $lists{$arg} = $list;
+  }
+  croak("aggregate: by is required") unless @{ $lists{by} };
+
+  return $self->_aggregate(@lists{qw(by sum min max)}, $args{count} ? 1 : 0);
+}
+
+###############################################
+# What changed since the last call; the scans
+# are compared in ProcessTable.xs.
+###############################################
+sub delta
+{
+  my ($self, %args) = @_;
+
+  my $changed = defined $args{changed} ? $args{changed} : { time => 0, rss => 0 };
+  $changed = { map { $_ => 0 } @$changed } if ref $changed eq 'ARRAY';
+  croak("delta: changed must be a hash of field names and thresholds")
+    unless ref $changed eq 'HASH';
+  my @names = sort keys %$changed;
+  foreach my $name (@names)
+  {
+    my $limit = $changed->{$name};
+    croak("delta: the threshold for $name must be a number that isn't negative")
+      unless looks_like_number($limit) && $limit >= 0;
+  }
+
+  return $self->_delta(\@names, [ @{$changed}{@names} ]);
+}
+
+###############################################
+# Background sampling. The thread and the
+# snapshots it publishes live in ProcessTable.xs;
+# the sampler stops when the object goes away.
+###############################################
+sub _start_sampler
+{
+  my ($self, $method, $notify, %args) = @_;
+
+  croak("$method: background sampling is not supported on $^O")
+    unless defined &_sampler_start;
+
+  my $interval = defined $args{interval} ? $args{interval} : 1000;
+  croak("$method: interval must be a positive number of milliseconds")
+    unless $interval =~ /^\d+$/ && $interval > 0;
+
+  $self->stop_sampler;
+  return $self->_sampler_start($interval, $notify);
+}
+
+sub start_sampler
+{
+  my ($self, %args) = @_;
+
+  $self->_start_sampler('start_sampler', 0, %args);
+  return $self;
+}
+
+# Same thread, but the returned fd becomes readable after each scan
+sub start_async
+{
+  my ($self, %args) = @_;
+
+  return $self->_start_sampler('start_async', 1, %args);
+}
+
+sub latest
+{
+  my $self = shift;
+
+  croak("latest: no sampler running, call start_sampler first")
+    unless $self->{Sampler};
+  return $self->_sampler_latest(0);
+}
+
+sub harvest
+{
+  my $self = shift;
+
+  croak("harvest: no sampler running, call start_async first")
+    unless $self->{Sampler};
+  return $self->_sampler_latest(1);
+}
+
+sub stop_sampler
+{
+  my $self = shift;
+
+  delete $self->{Sampler};
+  return $self;
+}
+
+# A thread doesn't get its own copy of the sampler
+sub Proc::ProcessTable::Sampler::CLONE_SKIP { 1 }
+
+# nor of the counters kept for rates
+sub Proc::ProcessTable::Rates::CLONE_SKIP { 1 }
+
+###############################################
+# Sample a process and its descendants; the
+# thread and the ring buffer live in
+# ProcessTable.xs.
+###############################################
+sub profile
+{
+  my ($self, %args) = @_;
+
+  croak("profile: profiling is not supported on $^O")
+    unless defined &_profile_start;
+
+  my $pid = $args{pid};
+  croak("profile: pid must be a process id")
+    unless defined $pid && $pid =~ /^\d+$/ && $pid > 0;
+
+  my $hz = defined $args{hz} ? $args{hz} : 10;
+  croak("profile: hz must be a whole number from 1 to 1000")
+    unless $hz =~ /^\d+$/ && $hz >= 1 && $hz <= 1000;
+
+  my $size = defined $args{size} ? $args{size} : 100000;
+  croak("profile: size must be a positive number of samples")
+    unless $size =~ /^\d+$/ && $size > 0;
+
+  return $self->_profile_start($pid, $hz, $size);
+}
+
+###############################################
+# Process events from the kernel; the socket
+# and the live table live in ProcessTable.xs.
+###############################################
+sub events
+{
+  my ($self, %args) = @_;
+
+  croak("events: process events are not supported on $^O")
+    unless defined &_events_open;
+
+  return $self->_events_open($args{live} ? 1 : 0);
+}
+
+###############################################
+# Exit accounting from taskstats; the socket
+# and the totals live in ProcessTable.xs.
+###############################################
+sub exits
+{
+  my ($self, %args) = @_;
+
+  croak("exits: exit accounting is not supported on $^O")
+    unless defined &_exits_open;
+
+  my $by = $args{by};
+  croak("exits: by must be uid or fname")
+    if defined $by && $by ne 'uid' && $by ne 'fname';
+
+  return $self->_exits_open(defined $by ? ord($by) : 0);
+}
+
+sub wait_exit
+{
+  my ($self, %args) = @_;
+
+  my $pids = $args{pids};
+  croak("wait_exit: pids must be an array reference")
+    unless ref $pids eq 'ARRAY';
+  for (qw(timeout poll)) {
+    croak("wait_exit: $_ must be a number of seconds")
+      if defined $args{$_} && !looks_like_number($args{$_});
+  }
+  my $timeout = defined $args{timeout} ? $args{timeout} : -1;
+  my $poll = defined $args{poll} ? $args{poll} : 0.1;
+
+  return $self->_wait_exit($pids, $args{all} ? 1 : 0,
+                           $timeout < 0 ? -1 : int($timeout * 1000),
+                           int($poll * 1000))
+    if defined &_wait_exit;
+
+  # no pidfds here, so check each pid with kill 0
+  require Time::HiRes;
+  my $deadline = Time::HiRes::time() + $timeout;
+  while (1) {
+    my @gone = grep { !kill(0, $_) && !$!{EPERM} } @$pids;
+    return @gone
+      if ($args{all} ? @gone == @$pids : @gone)
+      || ($timeout >= 0 && Time::HiRes::time() >= $deadline);
+    Time::HiRes::sleep($poll);
+  }
+}
+
+# I/O scheduling classes, for apply( ioprio => 'be/4' )
+my %IOPRIO_CLASS = (none => 0, rt => 1, be => 2, idle => 3);
+
+sub apply
+{
+  my ($self, %args) = @_;
+
+  my $where = $args{where};
+  croak("apply: where must be a hash reference")
+    unless ref $where eq 'HASH';
+  my @names = sort keys %$where;
+  my @alts = map { ref $where->{$_} eq 'ARRAY' ? $where->{$_} : [ $where->{$_} ] } @names;
+
+  my $ioprio = -1;
+  if (defined(my $io = $args{ioprio})) {
+    # only be and rt have levels
+    if ($io =~ m{^(none|idle)$} || $io =~ m{^(be|rt)(?:/([0-7]))?$}) {
+      $ioprio = ($IOPRIO_CLASS{$1} << 13) | (defined $2 ? $2 : $1 eq 'be' ? 4 : 0);
+    }
+    elsif ($io =~ /^\d+$/) {
+      $ioprio = $io;
+    }
+    else {
+      croak("apply: ioprio must be none, idle, be/0..7 or rt/0..7");
+    }
+  }
+
+  croak("apply: affinity must be an array reference of CPU numbers")
+    if defined $args{affinity} && ref $args{affinity} ne 'ARRAY';
+  croak("apply: nice must be a number")
+    if defined $args{nice} && !looks_like_number($args{nice});
+
+  my $sig;
+  if (defined $args{signal}) {
+    $sig = _signo($args{signal});
+    croak("apply: unrecognized signal name \"$args{signal}\"") unless defined $sig;
+  }
+
+  return $self->_apply(\@names, \@alts, $args{nice}, $ioprio, $args{affinity}, $sig);
+}
+
+# Apparently needed for mod_perl
+sub DESTROY {}
+
+1;
+__END__
+
+=head1 NAME
+
+Proc::ProcessTable - Perl extension to access the unix process table
+
+=head1 SYNOPSIS
+
+  use Proc::ProcessTable;
+
+  my $p = Proc::ProcessTable->new( 'cache_ttys' => 1 ); 
+  my @fields = $p->fields;
+  my $ref = $p->table;
+
+=head1 DESCRIPTION
+
+Perl interface to the unix process table.
+
+=head1 METHODS
+
+=over 4
+
+=item new
+
+Creates a new ProcessTable object. The constructor can take the following
+flags:
+
+enable_ttys -- causes the constructor to use the tty determination code,
+which is the default behavior.  Setting this to 0 disables this code,
+thus preventing the module from traversing the device tree, which on some
+systems, can be quite large and/or contain invalid device paths (for example,
+Solaris does not clean up invalid device entries when disks are swapped).  If
+this is specified with cache_ttys, a warning is generated and the cache_ttys
+is overridden to be false.
+
+cache_ttys -- causes the constructor to look for and use a file that
+caches a mapping of tty names to device numbers, and to create the
+file if it doesn't exist. This feature requires the Storable module.
+By default, the cache file name consists of a prefix F</tmp/TTYDEVS_> and a
+byte order tag. The file name can be accessed (and changed) via
+C<$Proc::ProcessTable::TTYDEVSFILE>.
+
+=item fields
+
+Returns a list of the field names supported by the module on the
+current architecture. On Linux this doesn't read the process table.
+
+=item schema
+
+  for my $field ($t->schema) {
+    print "$field->{name}: $field->{type}\n";
+  }
+
+Like C<fields>, but returns a hash for each field with its C<name>, its
+C<type> (C<int>, C<long>, C<string>, C<array> or C<scalar>) and its
+C<unit> (C<bytes>, C<microseconds>, C<epoch seconds> or C<percent>, undef
+for fields without a unit or where the OS code doesn't tell). C<ttydev>
+is not listed; it is the string looked up for C<ttynum>.
+
+=item table
+
+Reads the process table and returns a reference to an array of
+Proc::ProcessTable::Process objects. Attributes of a process object
+are returned by accessors named for the attribute; for example, to get
+the uid of a process just do:
+
+$process->uid
+
+The priority and pgrp methods also allow values to be set, since these
+are supported directly by internal perl functions.
+
+With the C<packed> option
+
+  my $snap = $t->table( packed => 1 );
+
+no process objects are built. Instead the process table is kept as one
+block of C records and returned as a L<Proc::ProcessTable::Snapshot>
+object, which hands out lightweight
+L<Proc::ProcessTable::Process::View> objects that read their fields
+straight from the records. This uses a fraction of the memory of the
+default table on hosts with many processes. C<by_pid>, C<rollup> and
+the tree queries work on packed tables as well, C<by_pid> and C<rollup>
+return views then.
+
+With the C<refresh> option
+
+  my $procs = $t->table( refresh => 1 );
+
+processes that were already in the previous table of C<$t>, with the
+same pid and start time, keep their Proc::ProcessTable::Process object
+and its values are updated in place; only new processes get new
+objects, and processes that exited are left out. This is cheaper when
+polling the table, and references to process objects held elsewhere
+show the current values. Keys that aren't process fields, like those
+set by the caller, are kept; the totals of C<rollup> are removed.
+
+With the C<pidfds> option
+
+  my $procs = $t->table( pidfds => 1 );
+
+every process object gets a L<Proc::ProcessTable::Handle>, a pidfd
+opened right after the process was read and checked against its start
+time, as with C<< $p->handle >>. C<kill> on those objects can't signal
+another process that reused the pid, however old the table is. This
+takes a file descriptor per process and is only available on Linux.
+
+=item by_pid
+
+  my $p = $t->by_pid($pid);
+
+Returns the Proc::ProcessTable::Process object for C<$pid> from the
+array the last call to C<table> returned, or undef if there was no
+such process. C<table> builds a pid index for this while it reads the
+process table, so lookups don't need a perl hash of the whole table.
+If C<table> hasn't been called yet, it is called first.
+
+=item children
+
+=item descendants
+
+=item ancestors
+
+  my @kids    = $t->children($pid);
+  my @family  = $t->descendants($pid);
+  my @lineage = $t->ancestors($pid);
+
+Return the pids of the direct children, of all descendants, or of the
+ancestors of C<$pid> in the table the last call to C<table> returned
+(reading one first if there is none yet). C<table> builds the process
+tree from the C<ppid> fields while it reads the process table, so each
+query only visits the processes it returns. C<descendants> lists
+parents before their children, C<ancestors> starts with the parent.
+Pids that aren't in the table have no relatives.
+
+=item rollup
+
+  my ($job) = $t->rollup($pid);
+  printf "%d processes, %d bytes resident\n", $job->tree_count, $job->tree_rss;
+
+Computes the resource totals of process subtrees of the last table (reading
+one first if there is none yet), in one pass over each subtree. Every
+process of a subtree gets these fields, covering the process and all its
+descendants:
+
+  tree_rss      sum of rss
+  tree_size     sum of size
+  tree_time     sum of time
+  tree_minflt   sum of minflt
+  tree_majflt   sum of majflt
+  tree_count    number of processes
+
+Fields the operating system doesn't provide are left out. With pids as
+arguments only the subtrees below these processes are rolled up;
+without, the whole table is. Returns the process objects of the roots,
+that is of the given pids or of the processes without a parent in the
+table.
+
+=item top
+
+  my $top = $t->top( n => 20, by => [ '-rss', 'pid' ] );
+
+Reads the process table like C<table>, but returns a reference to an
+array of only the C<n> highest ranked processes, best first. C<by> is a
+field name or a list of field names to sort on; a leading C<-> sorts
+that field in descending order, a leading C<+> (or none) in ascending
+order. Later fields break ties of earlier ones. String fields holding
+numbers (like C<pctcpu>) are compared numerically, processes without a
+value for a field sort last. C<by> defaults to C<-pctcpu>.
+
+The selection is done while the table is read, so the cost is about
+that of C<table> without creating an object for every process. Sorting
+on an unknown field is an error; note that C<ttydev> is derived from
+C<ttynum> and can't be sorted on.
+
+=item aggregate
+
+  my $groups = $t->aggregate( by => 'uid', sum => [qw(rss time)], count => 1 );
+
+Reads the process table and returns a reference to an array with one
+hash per group of processes that share the values of the C<by> field(s),
+for example C<uid>, C<fname>, C<ppid> or C<state>. Each hash holds the
+group's C<by> values under their field names, and the requested
+aggregates:
+
+  count       number of processes in the group (with count => 1)
+  sum_FIELD   sum of FIELD over the group (for each field in sum)
+  min_FIELD   smallest value of FIELD (for each field in min)
+  max_FIELD   largest value of FIELD (for each field in max)
+
+C<by>, C<sum>, C<min> and C<max> take a field name or a list of field
+names. Processes without a value for an aggregated field don't
+contribute to it; if no process of a group has one, the aggregate is
+undef. The groups are returned in the order they were first seen.
+
+The aggregation is done while the table is read, no process objects
+are created.
+
+=item delta
+
+  my ($new, $exited, $changed) = $t->delta( changed => { rss => 1 << 20 } );
+
+Reads the process table and compares it with the one the previous call
+to C<delta> read, returning three references to arrays of
+L<Proc::ProcessTable::Process::View> objects: the processes that
+appeared, those that exited, and those where one of the C<changed>
+fields moved by more than its threshold. Processes are matched by pid
+and start time, so a reused pid shows up as one exit and one new
+process; exited processes are views of the previous table. On the first
+call every process is new.
+
+C<changed> maps field names to thresholds, or is a list of field names
+that count on any change; it defaults to C<time> and C<rss> with a
+threshold of 0. The comparison is done on packed tables in C, so no
+process objects are built for processes that didn't change. The tables
+kept for C<delta> are separate from those of C<table>.
+
+=item rates
+
+  my $rates = $t->rates;
+  sleep 5;
+  $rates = $t->rates;
+  printf "%d: %.1f%% cpu\n", $_, $rates->{$_}{pctcpu} for keys %$rates;
+
+Reads the process table and returns a reference to a hash of the
+processes that were also there in the previous call to C<rates>, by
+pid. For each it has the rates over the time between the two calls:
+C<pctcpu>, C<pctuser> and C<pctsys>, the CPU used in percent of one
+CPU, and C<minflt_rate> and C<majflt_rate>, the page faults per second.
+Unlike the C<pctcpu> field, which is averaged over the life of the
+process, this shows what is busy now. Processes are matched by pid and
+start time, and the time between the calls is taken from the
+monotonic clock. The first call only records the counters and returns
+an empty hash.
+
+=item events
+
+  my $ev = $t->events( live => 1 );
+
+Subscribes to the kernel's process events and returns a
+L<Proc::ProcessTable::Events>, which has a file descriptor to wait on
+and returns every fork, exec and exit. With C<live>, it also keeps a
+process table that it updates from the events instead of reading all
+of F</proc> again. This is only available on Linux, and needs root or
+C<CAP_NET_ADMIN>.
+
+=item exits
+
+  my $exits = $t->exits( by => 'uid' );
+
+Registers for the final accounting of every process that exits, from
+the kernel's taskstats interface, and returns a
+L<Proc::ProcessTable::Exits>. That sees the CPU time, memory high
+water marks, I/O and delays of processes too short lived for C<table>,
+as a record per exit, or with C<by> (C<uid> or C<fname>) as totals.
+This is only available on Linux, and usually needs root.
+
+=item wait_exit
+
+  my @gone = $t->wait_exit( pids => \@pids, timeout => 10 );
+
+Sleeps until one of the processes in C<pids> exits, or all of them if
+C<all> is set, or C<timeout> seconds passed, and returns the pids that
+exited. On Linux it waits on a pidfd for each process, so it wakes up
+as soon as they exit without reading the process table at all. Where
+that is not available it checks every C<poll> seconds (default 0.1)
+whether the pids are still there. Pids that don't exist to begin with
+count as exited, and so do zombies when pidfds are used.
+
+=item apply
+
+  my $res = $t->apply( where    => { fname => qr/^worker/, uid => 1000 },
+                       nice     => 10,
+                       ioprio   => 'idle',
+                       affinity => [ 2, 3 ],
+                       signal   => 'HUP' );
+  warn "$_: ", ($! = $res->{$_}), "\n" for grep { $res->{$_} } keys %$res;
+
+Changes every process that matches C<where> in one call, and returns a
+reference to a hash of the pids it matched, with 0 for those where all
+went well and the errno of the first operation that failed otherwise.
+The caller itself is never matched.
+
+C<where> maps field names to what they must be: a value, which is
+compared as a number if the field is numeric and as a string if not, a
+C<qr//> pattern, or a reference to an array of those, any of which may
+match. All fields must match, and C<< where => {} >> matches every
+process. Only the fields in C<where> are read, on Linux, and no process
+objects are built.
+
+The operations, in the order they are done, are
+
+  nice      the nice value, with setpriority
+  ioprio    the I/O priority: none, idle, be/0..7, rt/0..7 (be alone
+            is be/4), or the raw value of ioprio_set
+  affinity  the CPUs the process may run on
+  signal    a signal, by name or number; negative for the process group
+
+C<ioprio> and C<affinity> are only available on Linux, elsewhere they
+fail with C<ENOSYS>. On Linux they apply to the main thread of the
+process, as C<taskset> and C<ionice> do without C<-a>.
+
+Only the signal is safe from pid reuse: on Linux it goes through a
+pidfd opened after checking the start time of the process, so a pid
+that exited and was reused after the scan is left alone (C<ESRCH>).
+C<nice>, C<ioprio> and C<affinity> have no pidfd variant and go to the
+pid. The pidfd is checked after each of them, and if the process is
+gone by then the result is C<ESRCH>: the call may have hit a process
+that got the same pid.
+
+=item profile
+
+  my $prof = $t->profile( pid => $pid, hz => 50 );
+
+Starts a thread that samples the process C<pid> and its descendants
+C<hz> times a second (default 10, at most 1000) and returns a
+L<Proc::ProcessTable::Profile>, which hands out the samples as TSV for
+F<contrib/ppt_profile_plot.R>. Only the processes of the tree are read
+for each sample. C<size> is the number of samples of single processes
+the buffer holds (default 100000). Profiling is only available on
+Linux.
+
+=item start_sampler
+
+=item latest
+
+=item stop_sampler
+
+  $t->start_sampler( interval => 500 );
+  ...
+  my $snap = $t->latest;
+  print $snap->count, " processes\n" if $snap;
+
+C<start_sampler> starts a thread that reads the process table every
+C<interval> milliseconds (default 1000) in the background. C<latest>
+returns the last complete table as a packed
+L<Proc::ProcessTable::Snapshot>, like C<table( packed =E<gt> 1 )>, or
+undef until the first one is done; it never reads F</proc> itself, so
+it costs the same however many processes there are. A snapshot stays
+valid for as long as it is referenced, the sampler starts a new one for
+its next scan. C<by_pid> and the tree queries work on the latest
+snapshot after a call to C<latest>.
+
+The thread never calls into perl. It stops when C<stop_sampler> is
+called or the object is destroyed, and it doesn't run in a child
+after C<fork>: there C<latest> keeps returning the last table of the
+parent. The sampler is only available on Linux.
+
+=item start_async
+
+=item harvest
+
+  my $fd = $t->start_async( interval => 1000 );
+  my $w = AnyEvent->io( fh => $fd, poll => 'r', cb => sub {
+    my $snap = $t->harvest or return;
+    ...
+  });
+
+C<start_async> starts the same thread as C<start_sampler> and takes the
+same options, but returns a file descriptor (an eventfd) that becomes
+readable each time a new table is done. C<harvest> never blocks: it
+resets the descriptor and returns the new snapshot, or undef if there
+has been none since the last call to C<harvest>. The descriptor
+belongs to the sampler and is closed by C<stop_sampler>, so don't read
+from or close it yourself; event loops that want a file handle rather
+than a number can watch a duplicate:
+
+  open( my $fh, '<&', $fd ) or die "dup: $!";
+
+=back
+
+=head1 EXAMPLES
+
+ # A cheap and sleazy version of ps
+ use Proc::ProcessTable;
+
+ my $FORMAT = "%-6s %-10s %-8s %-24s %s\n";
+ my $t = Proc::ProcessTable->new;
+ printf($FORMAT, "PID", "TTY", "STAT", "START", "COMMAND"); 
+ foreach my $p ( @{$t->table} ){
+   printf($FORMAT, 
+          $p->pid, 
+          $p->ttydev, 
+          $p->state, 
+          scalar(localtime($p->start)), 
+          $p->cmndline);
+ }
+
+
+ # Dump all the information in the current process table
+ use Proc::ProcessTable;
+
+ my $t = Proc::ProcessTable->new;
+
+ foreach my $p (@{$t->table}) {
+  print "--------------------------------\n";
+  foreach my $f ($t->fields){
+    print $f, ":  ", $p->{$f}, "\n";
+  }
+ }              
+
+=head1 CAVEATS
+
+Please see the file README in the distribution for a list of supported
+operating systems. Please see the file PORTING for information on how
+to help make this work on your OS.
+
+=head1 AUTHOR
+
+J. Bargsten, D. Urist
+
+=head1 SEE ALSO
+
+L<Proc::ProcessTable::Process>, L<Proc::ProcessTable::Profile>, L<Proc::ProcessTable::Events>, L<Proc::ProcessTable::Exits>, L<Proc::ProcessTable::Handle>, L<perl(1)>.
+
+=cut
+
+
@@ -0,0 +1,281 @@
+package Proc::ProcessTable::Process;
+
+use strict;
+use warnings;
+use vars qw($VERSION @ISA @EXPORT @EXPORT_OK $AUTOLOAD);
+
+require Exporter;
+require AutoLoader;
+
+@ISA = qw(Exporter AutoLoader);
+# Items to export into callers namespace by default. Note: do not export
+# names by default without a very good reason. Use EXPORT_OK instead.
+# Do not simply export all your public functions/methods/constants.
+@EXPORT = qw(
+	
+);
+$VERSION = '0.02';
+
+
+# Preloaded methods go here.
+use Carp;
+use File::Basename;
+use Scalar::Util qw(blessed reftype);
+
+########################################################
+# Accessors for the fields are installed by
+# ProcessTable.xs as real methods; this only gets
+# called for the tree_* fields of rollup, which get one
+# then, and for other keys of the hash, which don't.
+########################################################
+sub AUTOLOAD {
+  my $self = shift;
+  my $type = ref($self)
+    or croak "$self is not an object";
+  
+  my $name = $AUTOLOAD;
+  $name =~ s/.*://;		# strip fully-qualified portion
+  
+  unless (exists $self->{$name} ) {
+    croak "Can't access `$name' field in class $type";
+  }
+  _install_accessor($name);
+  
+  if (@_) {
+    return $self->{$name} = shift;
+  } else {
+    return $self->{$name};
+  }
+}
+
+########################################################
+# The Proc::ProcessTable::Handle of $p->handle or
+# table(pidfds => 1), if the object has one; views
+# are arrays and never do
+########################################################
+sub _handle {
+  return undef unless reftype($_[0]) eq 'HASH';
+  my $handle = $_[0]->{Handle};
+  return blessed($handle) ? $handle : undef;
+}
+
+########################################################
+# Kill; a wrapper for perl's kill, or a signal through
+# the pidfd if the object has a handle
+########################################################
+sub kill {
+  my ($self, $signal) = @_;
+  die "PID " . $self->pid . " not valid." unless($self->pid =~ /^-?\d+$/);
+  my $handle = $self->_handle;
+  # negative signals are for the process group
+  return( $handle->kill($signal) ? 1 : 0 ) if $handle && $signal !~ /^-/;
+  return( kill($signal, $self->pid) );
+}
+
+########################################################
+# Get/set accessors for priority and process group 
+# (everything else is just a get, so handled by autoload)
+#########################################################
+
+# Hmmm... These could use the perl functions to get if not stored on the object
+sub priority {
+  my ($self, $priority) = @_;
+  my $handle = $self->_handle;
+  if( defined($priority) && !($handle && !$handle->alive) ){
+    setpriority(0, $self->pid, $priority);
+    # Yuck; getpriority doesn't return a status. The pid was still
+    # the process's if the handle reaches it after both calls.
+    if( getpriority(0, $self->pid) == $priority && !($handle && !$handle->kill(0)) ){
+      $self->{priority} = $priority;
+    }
+  }
+  return $self->{priority};
+}
+
+sub pgrp {
+  my ($self, $pgrp) = @_;
+  my $handle = $self->_handle;
+  if( defined($pgrp) && !($handle && !$handle->alive) ){
+    setpgrp($self->pid, $pgrp);
+    if( getpgrp($self->pid) == $pgrp && !($handle && !$handle->kill(0)) ){ # Ditto setpgrp
+      $self->{pgrp} = $pgrp;
+    }
+  }
+  return $self->{pgrp};
+}
+
+########################################################
+# cmdline and environ are built when first read (see
+# ProcessTable.xs); Storable looks at the raw values,
+# so hand it a plain copy.
+########################################################
+sub STORABLE_freeze {
+  my ($self, $cloning) = @_;
+  my %copy = %$self;
+  # a pidfd doesn't survive being copied
+  delete $copy{Handle};
+  return ('', \%copy);
+}
+
+sub STORABLE_thaw {
+  my ($self, $cloning, $serialized, $copy) = @_;
+  %$self = %$copy;
+}
+
+# Apparently needed for mod_perl
+sub DESTROY {}
+
+# Autoload methods go after =cut, and are processed by the autosplit program.
+
+1;
+__END__
+
+=head1 NAME
+
+Proc::ProcessTable::Process - Perl process objects
+
+=head1 SYNOPSIS
+
+ $process->kill(9);
+ $process->priority(19);
+ $process->pgrp(500);
+ $uid = $process->uid;
+ ...
+
+=head1 DESCRIPTION
+
+This is a stub module to provide OO process attribute access for
+Proc::ProcessTable. Proc::ProcessTable::Process objects are
+constructed directly by Proc::ProcessTable; there is no constructor
+method, only accessors.
+
+=head1 METHODS
+
+=over 4
+
+=item kill
+
+Sends a signal to the process; just an aesthetic wrapper for perl's
+kill. Takes the signal (name or number) as an argument. Returns number
+of processes signalled. If the object has a handle (see below), the
+signal goes through it, so it can't hit another process that got the
+pid since the table was read.
+
+=item priority
+
+Get/set accessor; if called with a numeric argument, attempts to reset
+the process's priority to that number using perl's <B>setpriority
+function. Returns the process priority.
+
+=item pgrp
+
+Same as above for the process group.
+
+Unlike C<kill>, these two can't go through a handle: setpriority and
+setpgrp only take a pid, which may have been given to another process
+since the table was read. With a handle they do nothing if the process
+already exited, and they check the handle again afterwards; the new
+value is only stored on the object if the process was still there, but
+by then the call may have changed the other process.
+
+=item argv
+
+Takes an index and returns that element of C<cmdline>; negative indices
+count from the end.
+
+=item env
+
+Takes a variable name and returns its value from C<environ>, or undef.
+
+The C<cmdline> and C<environ> arrays are only built when they are first
+read; C<argv> and C<env> look up single values without building them.
+
+=item handle
+
+  my $h = $p->handle or print "gone\n";
+
+Opens a pidfd for the process and returns it as a
+L<Proc::ProcessTable::Handle>, or undef if the process exited or its
+pid now belongs to another process with a different start time. The
+handle is kept on the object (as C<< $p->{Handle} >>) and from then on
+C<kill> signals through it, and C<priority> and C<pgrp> don't set
+anything once the process exited. C<< $t->table( pidfds => 1 ) >>
+opens one for every process. Only on Linux 5.3 and later.
+
+=item refresh
+
+  $p->refresh or print "gone\n";
+  $p->refresh( fields => [ qw(utime stime rss) ] );
+
+Reads the current values of this process again and updates the object
+in place. With C<fields>, only those fields are updated, and on Linux
+only the files of F</proc> they come from are read. Returns false, and
+leaves the object alone, if the process exited or its pid now belongs
+to another process with a different start time. On systems without a
+way to read a single process this reads the whole process table.
+
+=item all other methods...
+
+are simple accessors that retrieve the process attributes for which
+they are named. Currently supported are:
+
+  uid         UID of process
+  gid         GID of process
+  euid        effective UID of process           (Solaris only)
+  egid        effective GID of process           (Solaris only)
+  pid         process ID
+  ppid        parent process ID
+  spid        sprod ID                           (IRIX only)
+  pgrp        process group
+  sess        session ID
+  cpuid       CPU ID of processor running on     (IRIX only)
+  priority    priority of process
+  ttynum      tty number of process
+  flags       flags of process
+  minflt      minor page faults                  (Linux only)
+  cminflt     child minor page faults            (Linux only)
+  majflt      major page faults                  (Linux only)
+  cmajflt     child major page faults            (Linux only)
+  utime       user mode time (1/100s of seconds) (Linux only)
+  stime       kernel mode time                   (Linux only)
+  cutime      child utime                        (Linux only)
+  cstime      child stime                        (Linux only)
+  time        user + system time                 
+  ctime       child user + system time
+  timensec    user + system nanoseconds part	 (Solaris only)
+  ctimensec   child user + system nanoseconds    (Solaris only)
+  qtime       cumulative cpu time                (IRIX only)
+  size        virtual memory size (bytes)
+  rss         resident set size (bytes)
+  wchan       address of current system call 
+  fname       file name
+  start       start time (seconds since the epoch)
+  pctcpu      percent cpu used since process started
+  state       state of process
+  pctmem      percent memory			 
+  cmndline    full command line of process
+  ttydev      path of process's tty
+  clname      scheduling class name              (IRIX only)
+
+See the "README.osname" files in the distribution for more
+up-to-date information. 
+
+The accessors are real (XS) methods, installed for all fields when the
+module is loaded, or on systems whose OS code doesn't list its fields
+up front, once the first process table has been read. Other hash
+entries are still read through AUTOLOAD; only the C<tree_*> fields of
+L<Proc::ProcessTable/rollup> get an accessor on first use. Called with an argument, an accessor stores it as the
+new value; only fields the object has can be set. The value returned is
+a copy.
+
+=back
+
+=head1 AUTHOR
+
+J. Bargsten, D. Urist
+
+=head1 SEE ALSO
+
+L<Proc::ProcessTable>, L<perl(1)>.
+
+=cut
@@ -0,0 +1,120 @@
+package Proc::ProcessTable::Process::View;
+
+use strict;
+use warnings;
+use vars qw($VERSION @ISA $AUTOLOAD);
+
+use Proc::ProcessTable::Process;
+
+@ISA = qw(Proc::ProcessTable::Process);
+
+$VERSION = '0.01';
+
+use Carp;
+
+# A view is [ snapshot, index ]; fields are read from the snapshot.
+# Like for Proc::ProcessTable::Process, the accessors are installed by
+# ProcessTable.xs and this is only the fallback for unknown names.
+sub AUTOLOAD {
+  my $self = shift;
+  ref($self)
+    or croak "$self is not an object";
+
+  my $name = $AUTOLOAD;
+  $name =~ s/.*://;		# strip fully-qualified portion
+
+  croak "Can't set `$name' field of a process view" if @_;
+
+  my $value = $self->[0]->_field($self->[1], $name);
+  Proc::ProcessTable::Process::_install_accessor($name);
+  return $value;
+}
+
+########################################################
+# A full Proc::ProcessTable::Process for this view
+########################################################
+sub as_hash {
+  my ($self) = @_;
+  return $self->[0]->_bless($self->[1]);
+}
+
+########################################################
+# The setters of Proc::ProcessTable::Process store
+# into the hash; views just act on the process
+########################################################
+sub priority {
+  my ($self, $priority) = @_;
+  if( defined($priority) ){
+    setpriority(0, $self->pid, $priority);
+    return getpriority(0, $self->pid);
+  }
+  return $self->[0]->_field($self->[1], 'priority');
+}
+
+sub pgrp {
+  my ($self, $pgrp) = @_;
+  if( defined($pgrp) ){
+    setpgrp($self->pid, $pgrp);
+    return getpgrp($self->pid);
+  }
+  return $self->[0]->_field($self->[1], 'pgrp');
+}
+
+sub refresh {
+  croak "Can't refresh a process view, refresh its as_hash instead";
+}
+
+# The snapshot lives in C memory and can't be stored
+sub STORABLE_freeze {
+  croak "Can't store a process view, store its as_hash instead";
+}
+
+sub DESTROY {}
+
+1;
+__END__
+
+=head1 NAME
+
+Proc::ProcessTable::Process::View - lightweight process objects
+
+=head1 SYNOPSIS
+
+ my $snap = $t->table( packed => 1 );
+ my $p = $snap->by_pid($$);
+ print $p->rss, "\n";
+ my $hash = $p->as_hash;
+
+=head1 DESCRIPTION
+
+Views are the process objects of packed tables (see
+L<Proc::ProcessTable::Snapshot>). A view is only a reference to its
+snapshot and an index; the accessors read the fields straight from the
+snapshot's records. They support the same accessors and the C<kill>,
+C<priority>, C<pgrp>, C<argv> and C<env> methods as L<Proc::ProcessTable::Process>, but
+not hash access.
+
+=head1 METHODS
+
+=over 4
+
+=item as_hash
+
+Returns a regular L<Proc::ProcessTable::Process> object with the values
+of this process.
+
+=item priority
+
+=item pgrp
+
+Like the methods of L<Proc::ProcessTable::Process>, but since the
+snapshot doesn't change, after setting a value they return the one
+the system reports now instead of storing it.
+
+=back
+
+=head1 SEE ALSO
+
+L<Proc::ProcessTable::Snapshot>, L<Proc::ProcessTable::Process>.
+
+=cut
@@ -0,0 +1,112 @@
+package Proc::ProcessTable::Snapshot;
+
+use strict;
+use warnings;
+use vars qw($VERSION);
+
+$VERSION = '0.01';
+
+# The XS parts (count, process, by_pid and the private _field and
+# _bless) live in ProcessTable.xs, which Proc::ProcessTable loads.
+use Proc::ProcessTable::Process::View;
+
+# The C side of a snapshot belongs to the thread that made it; new
+# threads get undef instead of a copy.
+sub CLONE_SKIP { 1 }
+
+sub processes {
+  my ($self) = @_;
+  return map { $self->process($_) } 0 .. $self->count - 1;
+}
+
+########################################################
+# Tied array interface; FETCH builds a full
+# Proc::ProcessTable::Process object for code that
+# wants hashes.
+########################################################
+sub TIEARRAY {
+  my ($class, $snapshot) = @_;
+  return $snapshot;
+}
+
+sub FETCHSIZE {
+  my ($self) = @_;
+  return $self->count;
+}
+
+sub FETCH {
+  my ($self, $i) = @_;
+  return undef if $i >= $self->count;
+  return $self->_bless($i);
+}
+
+sub EXISTS {
+  my ($self, $i) = @_;
+  return $i < $self->count;
+}
+
+1;
+__END__
+
+=head1 NAME
+
+Proc::ProcessTable::Snapshot - packed process table
+
+=head1 SYNOPSIS
+
+ my $snap = $t->table( packed => 1 );
+
+ printf "%d processes\n", $snap->count;
+ foreach my $p ( $snap->processes ) {
+   print $p->pid, " ", $p->fname, "\n";
+ }
+
+ # code that wants hashes
+ tie my @table, 'Proc::ProcessTable::Snapshot', $snap;
+ print $table[0]{pid}, "\n";
+
+=head1 DESCRIPTION
+
+A Proc::ProcessTable::Snapshot is what C<< Proc::ProcessTable->table(packed => 1) >>
+returns: the whole process table as one block of C records instead of
+an array of hash based objects. Processes are accessed through
+L<Proc::ProcessTable::Process::View> objects, which are just the
+snapshot and an index, and read their fields straight from the records.
+
+A snapshot doesn't change once it has been read; later calls to
+C<table> leave it alone.
+
+=head1 METHODS
+
+=over 4
+
+=item count
+
+Number of processes in the snapshot.
+
+=item process
+
+Takes an index and returns the view of that process, or undef if the
+index is out of range. Negative indices count from the end.
+
+=item processes
+
+Returns views of all processes.
+
+=item by_pid
+
+Takes a pid and returns the view of that process, or undef if it isn't
+in the snapshot.
+
+=back
+
+The snapshot can also be tied to an array, as shown in the synopsis.
+The elements of the tied array are regular
+L<Proc::ProcessTable::Process> objects built when they are fetched, so
+code written for C<table> keeps working, at the cost of building them.
+
+=head1 SEE ALSO
+
+L<Proc::ProcessTable>, L<Proc::ProcessTable::Process::View>.
+
+=cut
@@ -62,31 +62,30 @@ if ( $pid == 0 ) {
   print $log_fh join( "\t", qw/tp time pids rss vsz pcpu/ ), "\n";
 
   while ( kill( 0, $pid ) ) {
-    my $t  = Time::HiRes::tv_interval($script_start_time);
-    my $pt = parse_ppt( $ppt->table );
-
-    my @pids;
-    my $sum_rss   = 0;
-    my $sum_vsz   = 0;
-    my $sum_cpu   = 0;
-    my $sum_start = 0;
-
-    my %childs = map { $_ => 1 } subproc_ids( $pid, $pt );
-    $childs{$pid}++ if ( $opt{process_id} );
-    for my $p (@$pt) {
-      #[0] pid
-      #[1] ppid
-      #[2] rss
-      #[3] size
-      #[4] time
-      #[5] start
-      if ( $childs{ $p->[0] } ) {
-        $sum_rss += $p->[2];
-        $sum_vsz += $p->[3];
-        # utime + stime (cutime and cstime not needed, because we iterate through children
-        $sum_cpu += $p->[4];
-        push @pids, $p->[0];
-      }
+    my $t = Time::HiRes::tv_interval($script_start_time);
+    $ppt->table;
+
+    # subtree totals of the tracked process; without --pid the tracked
+    # process is our own fork running system(), so leave it out
+    my ($root) = $ppt->rollup($pid);
+    # a scan can miss the process (e.g. between fork and exec); only
+    # kill(0) above decides that it is gone
+    unless ($root) {
+      Time::HiRes::usleep($poll_intervall);
+      next;
+    }
+
+    my @pids    = $ppt->descendants($pid);
+    my $sum_rss = $root->tree_rss;
+    my $sum_vsz = $root->tree_size;
+    # utime + stime (cutime and cstime not needed, because we iterate through children
+    my $sum_cpu = $root->tree_time;
+    if ( $opt{process_id} ) {
+      unshift @pids, $pid;
+    } else {
+      $sum_rss -= $root->rss;
+      $sum_vsz -= $root->size;
+      $sum_cpu -= $root->time;
     }
 
 # calc pct cpu per interval:
@@ -116,24 +115,6 @@ if ( $pid == 0 ) {
   $log_fh->close;
 }
 
-sub parse_ppt {
-  my $ppt_table = shift;
-
-  my @table = map { [ $_->pid, $_->ppid, $_->rss, $_->size, $_->time, $_->start ] } @$ppt_table;
-  return \@table;
-}
-
-sub subproc_ids {
-  my ( $pid, $procs ) = @_;
-  #[ pid, parentid ]
-  my @childs;
-  for my $c ( grep { $_->[1] == $pid } @$procs ) {
-    push @childs, $c->[0];
-    push @childs, subproc_ids( $c->[0], $procs );
-  }
-  return @childs;
-}
-
 __END__
 
 =head1 NAME
@@ -10,3 +10,31 @@ if( $Config{libs} !~ /(?:^|\s)$thread_lib(?:\s|$)/ ) {
   $self->{LIBS} ||= [];
   push @{ $self->{LIBS} }, $thread_lib;
 }
+
+# os/Linux.c can read a single process for $p->refresh
+$self->{DEFINE} .= " -DPROCESSTABLE_GET_PROC";
+
+# os/Linux.c keeps no state between scans, so threads don't need to
+# take turns
+$self->{DEFINE} .= " -DPROCESSTABLE_OS_REENTRANT";
+
+# os/Linux.c knows its fields without reading /proc
+$self->{DEFINE} .= " -DPROCESSTABLE_OS_FIELDS";
+
+# and can run a scan on a thread without perl, for start_sampler
+$self->{DEFINE} .= " -DPROCESSTABLE_SAMPLER";
+
+# os/Linux.c can list the children of a process, for $t->profile
+$self->{DEFINE} .= " -DPROCESSTABLE_OS_CHILDREN";
+
+# and process events come from the kernel's proc connector
+$self->{DEFINE} .= " -DPROCESSTABLE_PROC_EVENTS";
+
+# and exit accounting from taskstats
+$self->{DEFINE} .= " -DPROCESSTABLE_TASKSTATS";
+
+# and can wait for processes with pidfds, for wait_exit
+$self->{DEFINE} .= " -DPROCESSTABLE_PIDFD";
+
+# and can set the I/O priority and CPU affinity of processes, for apply
+$self->{DEFINE} .= " -DPROCESSTABLE_SETSCHED";
@@ -49,20 +49,11 @@ sub killall {
 	$self = 0 unless defined $self;
 	my $nkilled = 0;
 	croak("killall: Unsupported signal: $signal") unless is_sig($signal);
-	my $t = Proc::ProcessTable->new;
-	my $BANG = undef;
-	foreach my $p (@{$t->table}) {
-	  my $cmndline = $p->{cmndline} || $p->{fname};
-	  if ($cmndline =~ /$pat/) {
-			next unless $p->pid != $$ || $self;
-			if (kill $signal, $p->pid) {
-				$nkilled++;
-			} else {
-				$BANG = $!;
-			}
-		}
-	}
-	$! = $BANG if defined $BANG;
+	# no process objects, so no tty names needed either
+	my $t = Proc::ProcessTable->new(enable_ttys => 0);
+	my $err;
+	($nkilled, $err) = $t->_killall(Proc::ProcessTable::_signo($signal), qr/$pat/, $self);
+	$! = $err if $err;
 	return $nkilled;
 }
 
@@ -95,6 +86,13 @@ were successfully signaled. If any kills failed, the C<$!> variable
 will be set based on that last one that failed (even if a successful kill
 happened afterward).
 
+The process table is read without building process objects or the tty
+map, and only the command line, name, pid and start time of each
+process are read where the system allows that. On Linux the signals
+are sent through a pidfd of each matching process, after checking its
+start time, so a process that exited while the table was read doesn't
+get its pid reused under the signal.
+
 =head1 AUTHOR
 
 Written in 2000 by Aaron Sherman E<lt>ajs@ajs.comE<gt>
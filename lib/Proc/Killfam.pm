@@ -4,8 +4,8 @@ package Proc::Killfam;
 
 use Exporter;
 use base qw/Exporter/;
-use subs qw/get_pids/;
 use vars qw/@EXPORT @EXPORT_OK $ppt_OK/;
+use Carp;
 use strict;
 use warnings;
 
@@ -23,36 +23,23 @@ BEGIN {
 
 sub killfam {
 
+    my $opts = ref $_[0] eq 'HASH' ? shift : {};
     my($signal, @pids) = @_;
 
     if ($ppt_OK) {
-	my $pt = Proc::ProcessTable->new;
-	my(@procs) =  @{$pt->table};
-	my(@kids) = get_pids \@procs, @pids;
-	@pids = (@pids, @kids);
+	# one scan of pid, ppid and start; see ProcessTable.xs
+	my $pt = Proc::ProcessTable->new(enable_ttys => 0);
+	my $sig = Proc::ProcessTable::_signo($signal);
+	croak "Unrecognized signal name \"$signal\"" unless defined $sig;
+	my($n, $err) = $pt->_killfam($sig, \@pids, $opts->{freeze} ? 1 : 0);
+	$! = $err if $err;
+	return $n;
     }
 
     kill $signal, @pids;
 
 } # end killfam
 
-sub get_pids {
-
-    my($procs, @kids) = @_;
-
-    my @pids;
-    foreach my $kid (@kids) {
-	foreach my $proc (@$procs) {
-	    if ($proc->ppid == $kid) {
-		my $pid = $proc->pid;
-		push @pids, $pid, get_pids $procs, $pid;
-	    } 
-	}
-    }
-    @pids;
-
-} # end get_pids
-
 1;
 
 __END__
@@ -65,12 +52,28 @@ Proc::Killfam - kill a list of pids, and all their sub-children
 
  use Proc::Killfam;
  killfam $signal, @pids;
+ killfam { freeze => 1 }, $signal, @pids;
 
 =head1 DESCRIPTION
 
 B<killfam> accepts the same arguments as the Perl builtin B<kill> command,
 but, additionally, recursively searches the process table for children and
-kills them as well.
+kills them as well. It returns the number of processes signalled, and
+sets C<$!> if any of them couldn't be.
+
+The descendants are all found in a single read of the process table,
+which only gets the pid, parent pid and start time of each process. On
+Linux the signals go through a pidfd of each process, checked against
+its start time, so a pid that was reused after the table was read isn't
+signalled.
+
+With a hash of options in front, C<< freeze => 1 >> first sends SIGSTOP
+to all of the processes, parents before their children, and then looks
+for children forked before their parent stopped (in the kernel's list of
+children of each stopped process on Linux, or by reading the process
+table again until nothing new turns up). Only then the signal is sent,
+followed by SIGCONT, so no process of the tree is left out, however fast
+it forks. The calling process itself is never stopped.
 
 =head1 EXAMPLE
 
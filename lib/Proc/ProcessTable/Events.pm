@@ -0,0 +1,97 @@
+package Proc::ProcessTable::Events;
+
+use strict;
+use warnings;
+use vars qw($VERSION);
+
+$VERSION = '0.01';
+
+# The methods live in ProcessTable.xs, which Proc::ProcessTable loads.
+
+# The socket belongs to the thread that opened it; new threads get
+# undef instead of a copy.
+sub CLONE_SKIP { 1 }
+
+1;
+__END__
+
+=head1 NAME
+
+Proc::ProcessTable::Events - fork, exec and exit events from the kernel
+
+=head1 SYNOPSIS
+
+ my $ev = $t->events( live => 1 );
+
+ my $w = AnyEvent->io( fh => $ev->fd, poll => 'r', cb => sub {
+   foreach my $e ( $ev->read ) {
+     print "$e->{what} $e->{pid}\n";
+   }
+ });
+
+ # the live table is up to date after each read
+ my $procs = $ev->table;
+
+=head1 DESCRIPTION
+
+A Proc::ProcessTable::Events is what C<< Proc::ProcessTable->events >>
+returns: a subscription to the Linux proc connector, which reports
+every fork, exec and exit as it happens, including processes too short
+lived to ever show up in C<table>. Subscribing needs the privileges the
+connector asks for, usually root or C<CAP_NET_ADMIN>; C<events> croaks
+if the kernel refuses.
+
+Made with C<< live => 1 >>, the object also keeps a table of
+L<Proc::ProcessTable::Process> objects. It reads the whole process
+table once, and after that only reads the processes that forked or
+exec'd and drops the ones that exited, so keeping it current costs in
+proportion to how many processes come and go rather than how many there
+are. Only these events are followed: a process changing its uid or its
+name without exec'ing keeps its old values.
+
+=head1 METHODS
+
+=over 4
+
+=item fd
+
+The file descriptor of the netlink socket. It is non-blocking and
+becomes readable when there are events. Don't read from or close it.
+
+=item read
+
+Returns the events that are waiting, without blocking, as hashes with
+these keys:
+
+ what         fork, exec or exit
+ pid          the process
+ tid          the thread; tid differs from pid for threads
+ ppid         the parent, for fork
+ exit_code    the wait status, for exit
+ exit_signal  the signal sent to the parent, for exit
+ cpu          the CPU the event happened on
+ time         seconds since boot
+
+The live table is updated as the events are read.
+
+=item table
+
+Returns a reference to an array of the process objects of the live
+table, in no particular order.
+
+=item by_pid
+
+Takes a pid and returns its object in the live table, or undef.
+
+=item lost
+
+How many times the kernel dropped events because they weren't read in
+time. The live table is read again when that happens.
+
+=back
+
+=head1 SEE ALSO
+
+L<Proc::ProcessTable>.
+
+=cut
@@ -0,0 +1,101 @@
+package Proc::ProcessTable::Exits;
+
+use strict;
+use warnings;
+use vars qw($VERSION);
+
+$VERSION = '0.01';
+
+# The methods live in ProcessTable.xs, which Proc::ProcessTable loads.
+
+# The socket belongs to the thread that opened it; new threads get
+# undef instead of a copy.
+sub CLONE_SKIP { 1 }
+
+1;
+__END__
+
+=head1 NAME
+
+Proc::ProcessTable::Exits - final accounting of exiting processes
+
+=head1 SYNOPSIS
+
+ # a record per exit
+ my $exits = $t->exits;
+ foreach my $e ( $exits->read ) {
+   printf "%s used %.3fs\n", $e->{fname}, $e->{time} / 1e6;
+ }
+
+ # CPU time by user
+ my $by_uid = $t->exits( by => 'uid' );
+ ...
+ $by_uid->read;
+ my $totals = $by_uid->totals( reset => 1 );
+ printf "%s: %d exits, %.1fs\n", $_, $totals->{$_}{count}, $totals->{$_}{time} / 1e6
+   for keys %$totals;
+
+=head1 DESCRIPTION
+
+A Proc::ProcessTable::Exits is what C<< Proc::ProcessTable->exits >>
+returns: a registration with the Linux taskstats interface for the
+exits on all CPUs. The kernel sends the final counters of every task
+that exits, so processes that live for a fraction of a second and
+never show up in C<table> are accounted for. Registering needs root on
+most kernels; C<exits> croaks if the kernel refuses. The fields of the
+delays are only filled in if the kernel does delay accounting
+(C<delayacct> on the kernel command line, or the
+C<kernel.task_delayacct> sysctl).
+
+Each thread is a task of its own, so a process with threads exits once
+per thread.
+
+=head1 METHODS
+
+=over 4
+
+=item fd
+
+The file descriptor of the netlink socket. It is non-blocking and
+becomes readable when there are exits. Don't read from or close it.
+
+=item read
+
+Reads the exits that are waiting, without blocking. Without C<by> it
+returns a hash for each, with the keys
+
+ pid ppid uid gid fname start   as in Proc::ProcessTable::Process
+ exit_code                      the wait status
+ elapsed                        run time, in microseconds
+ utime stime time               CPU time, in microseconds
+ minflt majflt                  page faults
+ maxrss maxsize                 high water marks, in bytes
+ rchar wchar                    bytes passed to read and write calls
+ read_bytes write_bytes         bytes of storage I/O
+ cpu_delay blkio_delay          delays waiting for a CPU, for I/O
+ swapin_delay                   and for swapping in, in microseconds
+
+With C<by> the exits are added to the totals instead and C<read>
+returns nothing.
+
+=item totals
+
+Returns a reference to a hash by uid or by fname, as given to
+C<exits>, of the totals of the exits read so far: C<count>, the sums of
+C<utime>, C<stime>, C<time>, C<minflt>, C<majflt>, C<rchar>, C<wchar>,
+C<read_bytes>, C<write_bytes>, C<cpu_delay>, C<blkio_delay> and
+C<swapin_delay>, and the largest C<maxrss>. With C<< reset => 1 >> the
+totals start over after that.
+
+=item lost
+
+How many times the kernel dropped exits because they weren't read in
+time.
+
+=back
+
+=head1 SEE ALSO
+
+L<Proc::ProcessTable>, L<Proc::ProcessTable::Events>.
+
+=cut
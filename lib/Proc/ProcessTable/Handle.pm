@@ -0,0 +1,89 @@
+package Proc::ProcessTable::Handle;
+
+use strict;
+use warnings;
+use Carp;
+use vars qw($VERSION);
+
+$VERSION = '0.01';
+
+# fd, pid, alive and _signal live in ProcessTable.xs, which
+# Proc::ProcessTable loads.
+
+sub kill {
+  my ($self, $signal) = @_;
+  my $sig = Proc::ProcessTable::_signo($signal);
+  croak("Unrecognized signal name \"$signal\"") unless defined $sig;
+  croak("Can't signal a process group through a handle") if $sig < 0;
+  return $self->_signal($sig);
+}
+
+# The pidfd belongs to the thread that opened it; new threads get
+# undef instead of a copy.
+sub CLONE_SKIP { 1 }
+
+1;
+__END__
+
+=head1 NAME
+
+Proc::ProcessTable::Handle - a pidfd for a process
+
+=head1 SYNOPSIS
+
+ my $procs = $t->table( pidfds => 1 );
+ ...
+ # seconds later, without reading the table again
+ $_->kill('TERM') foreach grep { $_->fname eq 'worker' } @$procs;
+
+ my $h = $p->handle or die "$p->{pid} is gone";
+ $h->kill(0) if $h->alive;
+
+=head1 DESCRIPTION
+
+A Proc::ProcessTable::Handle holds a pidfd, a file descriptor that
+refers to one process rather than to a pid. It is opened by
+C<< $p->handle >> of L<Proc::ProcessTable::Process>, or for every
+process by C<< $t->table( pidfds => 1 ) >>, and only if the process
+with the pid still has the start time of the object. Signals sent
+through it go to that process, or nowhere once it exited, even when
+the pid has been given to another process since.
+
+Once an object has a handle, its C<kill>, C<priority> and C<pgrp>
+methods use it: C<kill> signals through the pidfd, so only it is safe
+from pid reuse. The other two still call on the pid; they do nothing
+if the process already exited, and don't store the new value if it
+exited by the time the call returned. Handles are only available on Linux
+5.3 and later, and each takes a file descriptor until the object goes
+away, so mind C<ulimit -n> for big tables.
+
+=head1 METHODS
+
+=over 4
+
+=item kill
+
+Sends a signal, a name or a number, to the process. Returns true if it
+was sent, false with C<$!> set if not: C<ESRCH> once the process
+exited.
+
+=item alive
+
+True while the process hasn't exited.
+
+=item fd
+
+The pidfd. It becomes readable when the process exits, so it can be
+put in a C<select> or epoll set. Don't close it.
+
+=item pid
+
+The pid of the process.
+
+=back
+
+=head1 SEE ALSO
+
+L<Proc::ProcessTable>, L<Proc::ProcessTable::Process>.
+
+=cut
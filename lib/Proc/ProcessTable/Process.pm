@@ -20,7 +20,14 @@ $VERSION = '0.02';
 # Preloaded methods go here.
 use Carp;
 use File::Basename;
+use Scalar::Util qw(blessed reftype);
 
+########################################################
+# Accessors for the fields are installed by
+# ProcessTable.xs as real methods; this only gets
+# called for the tree_* fields of rollup, which get one
+# then, and for other keys of the hash, which don't.
+########################################################
 sub AUTOLOAD {
   my $self = shift;
   my $type = ref($self)
@@ -32,6 +39,7 @@ sub AUTOLOAD {
   unless (exists $self->{$name} ) {
     croak "Can't access `$name' field in class $type";
   }
+  _install_accessor($name);
   
   if (@_) {
     return $self->{$name} = shift;
@@ -41,11 +49,26 @@ sub AUTOLOAD {
 }
 
 ########################################################
-# Kill; just a wrapper for perl's kill at the moment
+# The Proc::ProcessTable::Handle of $p->handle or
+# table(pidfds => 1), if the object has one; views
+# are arrays and never do
+########################################################
+sub _handle {
+  return undef unless reftype($_[0]) eq 'HASH';
+  my $handle = $_[0]->{Handle};
+  return blessed($handle) ? $handle : undef;
+}
+
+########################################################
+# Kill; a wrapper for perl's kill, or a signal through
+# the pidfd if the object has a handle
 ########################################################
 sub kill {
   my ($self, $signal) = @_;
   die "PID " . $self->pid . " not valid." unless($self->pid =~ /^-?\d+$/);
+  my $handle = $self->_handle;
+  # negative signals are for the process group
+  return( $handle->kill($signal) ? 1 : 0 ) if $handle && $signal !~ /^-/;
   return( kill($signal, $self->pid) );
 }
 
@@ -57,9 +80,12 @@ sub kill {
 # Hmmm... These could use the perl functions to get if not stored on the object
 sub priority {
   my ($self, $priority) = @_;
-  if( defined($priority) ){
+  my $handle = $self->_handle;
+  if( defined($priority) && !($handle && !$handle->alive) ){
     setpriority(0, $self->pid, $priority);
-    if( getpriority(0, $self->pid) == $priority ){  # Yuck; getpriority doesn't return a status
+    # Yuck; getpriority doesn't return a status. The pid was still
+    # the process's if the handle reaches it after both calls.
+    if( getpriority(0, $self->pid) == $priority && !($handle && !$handle->kill(0)) ){
       $self->{priority} = $priority;
     }
   }
@@ -68,15 +94,33 @@ sub priority {
 
 sub pgrp {
   my ($self, $pgrp) = @_;
-  if( defined($pgrp) ){
+  my $handle = $self->_handle;
+  if( defined($pgrp) && !($handle && !$handle->alive) ){
     setpgrp($self->pid, $pgrp);
-    if( getpgrp($self->pid) == $pgrp ){ # Ditto setpgrp
+    if( getpgrp($self->pid) == $pgrp && !($handle && !$handle->kill(0)) ){ # Ditto setpgrp
       $self->{pgrp} = $pgrp;
     }
   }
   return $self->{pgrp};
 }
 
+########################################################
+# cmdline and environ are built when first read (see
+# ProcessTable.xs); Storable looks at the raw values,
+# so hand it a plain copy.
+########################################################
+sub STORABLE_freeze {
+  my ($self, $cloning) = @_;
+  my %copy = %$self;
+  # a pidfd doesn't survive being copied
+  delete $copy{Handle};
+  return ('', \%copy);
+}
+
+sub STORABLE_thaw {
+  my ($self, $cloning, $serialized, $copy) = @_;
+  %$self = %$copy;
+}
 
 # Apparently needed for mod_perl
 sub DESTROY {}
@@ -113,7 +157,9 @@ method, only accessors.
 
 Sends a signal to the process; just an aesthetic wrapper for perl's
 kill. Takes the signal (name or number) as an argument. Returns number
-of processes signalled.
+of processes signalled. If the object has a handle (see below), the
+signal goes through it, so it can't hit another process that got the
+pid since the table was read.
 
 =item priority
 
@@ -125,6 +171,49 @@ function. Returns the process priority.
 
 Same as above for the process group.
 
+Unlike C<kill>, these two can't go through a handle: setpriority and
+setpgrp only take a pid, which may have been given to another process
+since the table was read. With a handle they do nothing if the process
+already exited, and they check the handle again afterwards; the new
+value is only stored on the object if the process was still there, but
+by then the call may have changed the other process.
+
+=item argv
+
+Takes an index and returns that element of C<cmdline>; negative indices
+count from the end.
+
+=item env
+
+Takes a variable name and returns its value from C<environ>, or undef.
+
+The C<cmdline> and C<environ> arrays are only built when they are first
+read; C<argv> and C<env> look up single values without building them.
+
+=item handle
+
+  my $h = $p->handle or print "gone\n";
+
+Opens a pidfd for the process and returns it as a
+L<Proc::ProcessTable::Handle>, or undef if the process exited or its
+pid now belongs to another process with a different start time. The
+handle is kept on the object (as C<< $p->{Handle} >>) and from then on
+C<kill> signals through it, and C<priority> and C<pgrp> don't set
+anything once the process exited. C<< $t->table( pidfds => 1 ) >>
+opens one for every process. Only on Linux 5.3 and later.
+
+=item refresh
+
+  $p->refresh or print "gone\n";
+  $p->refresh( fields => [ qw(utime stime rss) ] );
+
+Reads the current values of this process again and updates the object
+in place. With C<fields>, only those fields are updated, and on Linux
+only the files of F</proc> they come from are read. Returns false, and
+leaves the object alone, if the process exited or its pid now belongs
+to another process with a different start time. On systems without a
+way to read a single process this reads the whole process table.
+
 =item all other methods...
 
 are simple accessors that retrieve the process attributes for which
@@ -171,6 +260,14 @@ they are named. Currently supported are:
 See the "README.osname" files in the distribution for more
 up-to-date information. 
 
+The accessors are real (XS) methods, installed for all fields when the
+module is loaded, or on systems whose OS code doesn't list its fields
+up front, once the first process table has been read. Other hash
+entries are still read through AUTOLOAD; only the C<tree_*> fields of
+L<Proc::ProcessTable/rollup> get an accessor on first use. Called with an argument, an accessor stores it as the
+new value; only fields the object has can be set. The value returned is
+a copy.
+
 =back
 
 =head1 AUTHOR
@@ -0,0 +1,96 @@
+package Proc::ProcessTable::Profile;
+
+use strict;
+use warnings;
+use Carp;
+use vars qw($VERSION);
+
+$VERSION = '0.01';
+
+# The XS parts (running, dropped, stop and the private _drain) live in
+# ProcessTable.xs, which Proc::ProcessTable loads.
+
+# The profiler thread belongs to the perl thread that started it; new
+# threads get undef instead of a copy.
+sub CLONE_SKIP { 1 }
+
+sub drain {
+  my ($self, $fh) = @_;
+
+  my $tsv = $self->_drain;
+  return $tsv unless defined $fh;
+  print {$fh} $tsv or croak("drain: can't write: $!");
+  return 1;
+}
+
+1;
+__END__
+
+=head1 NAME
+
+Proc::ProcessTable::Profile - sample a process tree in the background
+
+=head1 SYNOPSIS
+
+ my $prof = $t->profile( pid => $pid, hz => 50 );
+
+ open( my $log, '>', 'job.tsv' ) or die $!;
+ while ( $prof->running ) {
+   sleep 5;
+   $prof->drain($log);
+ }
+ $prof->drain($log);
+
+ # then: contrib/ppt_profile_plot.R job.tsv job.pdf
+
+=head1 DESCRIPTION
+
+A Proc::ProcessTable::Profile is what C<< Proc::ProcessTable->profile >>
+returns: a thread that samples the rss, size and CPU time of a process
+and all its descendants many times a second, without reading the rest
+of the process table, and keeps the samples in a ring buffer until
+they are drained.
+
+On kernels that list the children of a process under
+F</proc/E<lt>pidE<gt>/task/E<lt>tidE<gt>/children> the set of processes
+is updated on every sample; otherwise it is found from a scan of the
+whole process table once a second, so processes that start in between
+are picked up with a delay of up to a second.
+
+The profiler stops by itself when the process it follows exits, and
+when the object is destroyed.
+
+=head1 METHODS
+
+=over 4
+
+=item drain
+
+Takes the samples out of the buffer and returns them as TSV, one line
+per sample of the tree, in the format that F<contrib/ppt_profile.pl>
+writes and F<contrib/ppt_profile_plot.R> reads: the sample number, the
+seconds since the start, the pids, the total rss and size in bytes, and
+the CPU used since the previous sample as a fraction of one CPU. The
+first call starts with a header line. Given a file handle, C<drain>
+prints to it instead.
+
+=item running
+
+True until the followed process exits or C<stop> is called.
+
+=item dropped
+
+The number of samples that were overwritten because the buffer was
+full before C<drain> was called.
+
+=item stop
+
+Stops the thread. The samples taken so far can still be drained.
+
+=back
+
+=head1 SEE ALSO
+
+L<Proc::ProcessTable>.
+
+=cut
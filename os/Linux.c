@@ -173,6 +173,23 @@ char *OS_initialize()
   return NULL;
 }
 
+/* OS_get_fields()
+ *
+ * The fields OS_get_table passes to bless_into_proc, without reading /proc.
+ *
+ * @param   format  Set to the format string; all fields are in their ignore
+ *                  (upper) case, which get_proc lowers for the values found
+ * @param   units   Set to the unit of each field, NULL where there is none
+ * @return  The field names.
+ */
+char **OS_get_fields(char **format, const char *const **units)
+{
+  *format = (char *)get_string(STR_DEFAULT_FORMAT);
+  *units  = field_units;
+
+  return (char **)field_names;
+}
+
 inline static void field_enable(char *format_str, enum field field)
 {
   format_str[field] = tolower(format_str[field]);
@@ -717,15 +734,21 @@ inline static bool pid_exists(const char *str, struct obstack *mem_pool)
   return result;
 }
 
-void OS_get_table()
-{
-  /* dir walker storage */
-  DIR *          dir;
-  struct dirent *dir_ent, *dir_result;
-
-  /* all our storage is going to be here */
-  struct obstack mem_pool;
+/* get_proc()
+ *
+ * Scrape the values of one process and bless them into a perl object.
+ *
+ * @param   pid         String representing the pid
+ * @param   want        Flag per field (enum field) telling if it's needed, or
+ *                      NULL for all fields; the files only needed for
+ *                      unwanted fields aren't read
+ * @param   mem_pool    Obstack to use for temory storage
+ * @return  false if the process is gone.
+ */
+#define WANT(f)    (want == NULL || want[f])
 
+static bool get_proc(char *pid, const char *want, struct obstack *mem_pool)
+{
   /* container for scraped process values */
   struct procstat *prs;
 
@@ -733,6 +756,131 @@ void OS_get_table()
    * lower cased if we are able to figure them out */
   char *format_str;
 
+  /* allocate container for storing process values */
+  prs = obstack_alloc(mem_pool, sizeof(struct procstat));
+  bzero(prs, sizeof(struct procstat));
+
+  /* initialize the format string */
+  obstack_printf(mem_pool, "%s", get_string(STR_DEFAULT_FORMAT));
+  obstack_1grow(mem_pool, '\0');
+  format_str = (char *)obstack_finish(mem_pool);
+
+  /* get process' uid/guid */
+  if(WANT(F_UID) || WANT(F_GID)) {
+    get_user_info(pid, format_str, prs, mem_pool);
+  }
+
+  /* scrape /proc/${pid}/stat */
+  if(get_proc_stat(pid, format_str, prs, mem_pool) == false) {
+    /* did the pid directory go away mid flight? */
+    if(pid_exists(pid, mem_pool) == false) {
+      obstack_free(mem_pool, prs);
+      return false;
+    }
+  }
+
+  /* correct values (times) found in /proc/${pid}/stat */
+  fixup_stat_values(format_str, prs);
+
+  /* get process' cmndline */
+  if(WANT(F_CMNDLINE)) {
+    get_proc_cmndline(pid, format_str, prs, mem_pool);
+  }
+
+  /* get process' cmdline */
+  if(WANT(F_CMDLINE)) {
+    get_proc_cmdline(pid, format_str, prs, mem_pool);
+  }
+
+  /* get process' environ */
+  if(WANT(F_ENVIRON)) {
+    get_proc_environ(pid, format_str, prs, mem_pool);
+  }
+
+  /* get process' cwd & exec values from the symblink */
+  if(WANT(F_CWD)) {
+    eval_link(pid, "cwd", F_CWD, &prs->cwd, format_str, mem_pool);
+  }
+  if(WANT(F_EXEC)) {
+    eval_link(pid, "exe", F_EXEC, &prs->exec, format_str, mem_pool);
+  }
+
+  /* scrape from /proc/{$pid}/status */
+  if(WANT(F_EUID) || WANT(F_SUID) || WANT(F_FUID) || WANT(F_EGID) ||
+     WANT(F_SGID) || WANT(F_FGID) || WANT(F_TRACER)) {
+    get_proc_status(pid, format_str, prs, mem_pool);
+  }
+
+  /* calculate precent cpu & mem values */
+  calc_prec(format_str, prs, mem_pool);
+
+  /* Go ahead and bless into a perl object */
+  /* Linux.h defines const char* const* Fiels, but we cast it away, as bless_into_proc only understands char** */
+  bless_into_proc(format_str, (char **)field_names,
+                  prs->uid,
+                  prs->gid,
+                  prs->pid,
+                  prs->comm,
+                  prs->ppid,
+                  prs->pgrp,
+                  prs->sid,
+                  prs->tty,
+                  prs->flags,
+                  prs->minflt,
+                  prs->cminflt,
+                  prs->majflt,
+                  prs->cmajflt,
+                  prs->utime,
+                  prs->stime,
+                  prs->cutime,
+                  prs->cstime,
+                  prs->priority,
+                  prs->start_time,
+                  prs->vsize,
+                  prs->rss,
+                  prs->wchan,
+                  prs->time,
+                  prs->ctime,
+                  prs->state,
+                  prs->euid,
+                  prs->suid,
+                  prs->fuid,
+                  prs->egid,
+                  prs->sgid,
+                  prs->fgid,
+                  prs->pctcpu,
+                  prs->pctmem,
+                  prs->cmndline,
+                  prs->exec,
+                  prs->cwd,
+                  prs->cmdline,
+                  prs->cmdline_len,
+                  prs->environ,
+                  prs->environ_len,
+                  prs->tracer
+                  );
+
+  /* we want a new prs, for the next itteration */
+  obstack_free(mem_pool, prs);
+
+  return true;
+}
+
+/* get_procs()
+ *
+ * get_proc() for every process.
+ *
+ * @param   want        As for get_proc()
+ */
+static void get_procs(const char *want)
+{
+  /* dir walker storage */
+  DIR *          dir;
+  struct dirent *dir_ent, *dir_result;
+
+  /* all our storage is going to be here */
+  struct obstack mem_pool;
+
   /* initialize a small memory pool for this function */
   obstack_init(&mem_pool);
 
@@ -750,102 +898,116 @@ void OS_get_table()
       continue;
     }
 
-    /* allocate container for storing process values */
-    prs = obstack_alloc(&mem_pool, sizeof(struct procstat));
-    bzero(prs, sizeof(struct procstat));
+    get_proc(dir_result->d_name, want, &mem_pool);
+  }
 
-    /* initialize the format string */
-    obstack_printf(&mem_pool, "%s", get_string(STR_DEFAULT_FORMAT));
-    obstack_1grow(&mem_pool, '\0');
-    format_str = (char *)obstack_finish(&mem_pool);
+  closedir(dir);
 
-    /* get process' uid/guid */
-    get_user_info(dir_result->d_name, format_str, prs, &mem_pool);
+  /* free all our tempoary memory */
+  obstack_free(&mem_pool, NULL);
+}
+
+void OS_get_table()
+{
+  get_procs(NULL);
+}
 
-    /* scrape /proc/${pid}/stat */
-    if(get_proc_stat(dir_result->d_name, format_str, prs, &mem_pool) == false) {
-      /* did the pid directory go away mid flight? */
-      if(pid_exists(dir_result->d_name, &mem_pool) == false) {
-        continue;
+/* OS_get_proc()
+ *
+ * Like OS_get_table, for a single process, or for all of them with just
+ * some of the fields.
+ *
+ * @param   pid         The process, or -1 for all
+ * @param   fields      Names of the fields that are needed, or NULL for all
+ * @param   nfields     Number of names in fields
+ * @return  1 if the process was found, 0 if not.
+ */
+int OS_get_proc(long pid, char **fields, int nfields)
+{
+  struct obstack mem_pool;
+  char           pid_str[32];
+  char           want[F_TRACER + 1];
+  bool           found;
+  int            i, j;
+
+  if(fields != NULL) {
+    bzero(want, sizeof(want));
+    for(i = 0; i < nfields; i++) {
+      for(j = 0; j <= F_TRACER; j++) {
+        if(strcmp(fields[i], field_names[j]) == 0) {
+          want[j] = 1;
+        }
       }
     }
+  }
 
-    /* correct values (times) found in /proc/${pid}/stat */
-    fixup_stat_values(format_str, prs);
-
-    /* get process' cmndline */
-    get_proc_cmndline(dir_result->d_name, format_str, prs, &mem_pool);
-
-    /* get process' cmdline */
-    get_proc_cmdline(dir_result->d_name, format_str, prs, &mem_pool);
-
-    /* get process' environ */
-    get_proc_environ(dir_result->d_name, format_str, prs, &mem_pool);
-
-    /* get process' cwd & exec values from the symblink */
-    eval_link(dir_result->d_name, "cwd", F_CWD, &prs->cwd, format_str,
-              &mem_pool);
-    eval_link(dir_result->d_name, "exe", F_EXEC, &prs->exec, format_str,
-              &mem_pool);
-
-    /* scrape from /proc/{$pid}/status */
-    get_proc_status(dir_result->d_name, format_str, prs, &mem_pool);
-
-    /* calculate precent cpu & mem values */
-    calc_prec(format_str, prs, &mem_pool);
-
-    /* Go ahead and bless into a perl object */
-    /* Linux.h defines const char* const* Fiels, but we cast it away, as bless_into_proc only understands char** */
-    bless_into_proc(format_str, (char **)field_names,
-                    prs->uid,
-                    prs->gid,
-                    prs->pid,
-                    prs->comm,
-                    prs->ppid,
-                    prs->pgrp,
-                    prs->sid,
-                    prs->tty,
-                    prs->flags,
-                    prs->minflt,
-                    prs->cminflt,
-                    prs->majflt,
-                    prs->cmajflt,
-                    prs->utime,
-                    prs->stime,
-                    prs->cutime,
-                    prs->cstime,
-                    prs->priority,
-                    prs->start_time,
-                    prs->vsize,
-                    prs->rss,
-                    prs->wchan,
-                    prs->time,
-                    prs->ctime,
-                    prs->state,
-                    prs->euid,
-                    prs->suid,
-                    prs->fuid,
-                    prs->egid,
-                    prs->sgid,
-                    prs->fgid,
-                    prs->pctcpu,
-                    prs->pctmem,
-                    prs->cmndline,
-                    prs->exec,
-                    prs->cwd,
-                    prs->cmdline,
-                    prs->cmdline_len,
-                    prs->environ,
-                    prs->environ_len,
-                    prs->tracer
-                    );
-
-    /* we want a new prs, for the next itteration */
-    obstack_free(&mem_pool, prs);
+  if(pid == -1) {
+    get_procs(fields == NULL ? NULL : want);
+    return 1;
   }
 
-  closedir(dir);
+  snprintf(pid_str, sizeof(pid_str), "%ld", pid);
 
-  /* free all our tempoary memory */
+  obstack_init(&mem_pool);
+  found = get_proc(pid_str, fields == NULL ? NULL : want, &mem_pool);
   obstack_free(&mem_pool, NULL);
+
+  return found;
+}
+
+/* OS_get_children()
+ *
+ * The children of a process, from /proc/${pid}/task/${tid}/children,
+ * which the kernel only has with CONFIG_PROC_CHILDREN.
+ *
+ * @param   pid         The process
+ * @param   kids        Filled with up to max pids
+ * @param   max         Size of kids
+ * @return  The number of children, which may be more than max, or -1 if
+ *          the kernel doesn't list children.
+ */
+int OS_get_children(long pid, long *kids, int max)
+{
+  static int     supported = -1;
+  char           path[64];
+  DIR           *dir;
+  struct dirent *ent;
+  FILE          *fp;
+  long           kid;
+  int            n = 0;
+
+  /* our own main thread always exists */
+  if(supported < 0) {
+    snprintf(path, sizeof(path), "/proc/%ld/task/%ld/children", (long)getpid(), (long)getpid());
+    supported = access(path, R_OK) == 0;
+  }
+  if(!supported) {
+    return -1;
+  }
+
+  snprintf(path, sizeof(path), "/proc/%ld/task", pid);
+  if((dir = opendir(path)) == NULL) {
+    return 0;
+  }
+
+  /* children are listed by the thread that forked them */
+  while((ent = readdir(dir)) != NULL) {
+    if(!is_pid(ent->d_name)) {
+      continue;
+    }
+    snprintf(path, sizeof(path), "/proc/%ld/task/%s/children", pid, ent->d_name);
+    if((fp = fopen(path, "r")) == NULL) {
+      continue;
+    }
+    while(fscanf(fp, "%ld", &kid) == 1) {
+      if(n < max) {
+        kids[n] = kid;
+      }
+      n++;
+    }
+    fclose(fp);
+  }
+
+  closedir(dir);
+  return n;
 }
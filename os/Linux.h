@@ -334,3 +334,47 @@ static const char* const field_names[] =
     strings + 330
 };
 
+/* units of the fields, NULL where there is none */
+static const char* const field_units[] =
+{
+    NULL,                /* uid */
+    NULL,                /* gid */
+    NULL,                /* pid */
+    NULL,                /* fname */
+    NULL,                /* ppid */
+    NULL,                /* pgrp */
+    NULL,                /* sess */
+    NULL,                /* ttynum */
+    NULL,                /* flags */
+    NULL,                /* minflt */
+    NULL,                /* cminflt */
+    NULL,                /* majflt */
+    NULL,                /* cmajflt */
+    "microseconds",      /* utime */
+    "microseconds",      /* stime */
+    "microseconds",      /* cutime */
+    "microseconds",      /* cstime */
+    NULL,                /* priority */
+    "epoch seconds",     /* start */
+    "bytes",             /* size */
+    "bytes",             /* rss */
+    NULL,                /* wchan */
+    "microseconds",      /* time */
+    "microseconds",      /* ctime */
+    NULL,                /* state */
+    NULL,                /* euid */
+    NULL,                /* suid */
+    NULL,                /* fuid */
+    NULL,                /* egid */
+    NULL,                /* sgid */
+    NULL,                /* fgid */
+    "percent",           /* pctcpu */
+    "percent",           /* pctmem */
+    NULL,                /* cmndline */
+    NULL,                /* exec */
+    NULL,                /* cwd */
+    NULL,                /* cmdline */
+    NULL,                /* environ */
+    NULL                 /* tracer */
+};
+
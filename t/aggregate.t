@@ -0,0 +1,28 @@
+use strict;
+use warnings;
+use Test::More;
+
+use Proc::ProcessTable;
+
+my $t = Proc::ProcessTable->new( enable_ttys => 0 );
+
+my $groups = $t->aggregate( by => 'uid', sum => [qw(rss time)], max => 'rss', count => 1 );
+is( ref $groups, 'ARRAY', 'aggregate returns an array ref' );
+
+my ($mine) = grep { $_->{uid} == $< } @$groups;
+ok( $mine, 'there is a group for our uid' );
+ok( $mine->{count} >= 1, 'it counts at least this process' );
+ok( $mine->{sum_rss} >= $mine->{max_rss}, 'sum is at least the max' );
+ok( exists $mine->{sum_time}, 'sum of time is there' );
+
+my %uids;
+$uids{ $_->{uid} }++ for @$groups;
+ok( !( grep { $_ > 1 } values %uids ), 'one group per uid' );
+
+my $by_state = $t->aggregate( by => [qw(uid state)] );
+ok( !exists $by_state->[0]{count}, 'count is only returned on request' );
+
+eval { $t->aggregate( by => 'no_such_field' ) };
+like( $@, qr/unknown field `no_such_field'/, 'unknown group field' );
+
+done_testing();
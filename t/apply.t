@@ -0,0 +1,67 @@
+use strict;
+use warnings;
+use Test::More;
+use POSIX ();
+use Proc::ProcessTable;
+
+my $marker = "ppt_apply_$$";
+my $t = Proc::ProcessTable->new( enable_ttys => 0 );
+
+my @kids;
+for (1 .. 3) {
+  my $pid = fork;
+  die "fork: $!" unless defined $pid;
+  unless ($pid) {
+    $0 = "$marker $_";
+    sleep 30;
+    POSIX::_exit(0);
+  }
+  push @kids, $pid;
+}
+for (1 .. 50) {
+  last if grep({ ($_->cmndline || '') =~ /^$marker/ } @{ $t->table }) == 3;
+  select(undef, undef, undef, 0.05);
+}
+
+my $res = $t->apply( where => { cmndline => qr/^$marker/ }, signal => 0 );
+is_deeply([ sort { $a <=> $b } keys %$res ], [ sort { $a <=> $b } @kids ], 'where with a pattern');
+is_deeply([ values %$res ], [ 0, 0, 0 ], 'signal 0 to all');
+
+$res = $t->apply( where => { pid => [ @kids[0, 1] ], cmndline => qr/^$marker/ }, nice => 5 );
+is_deeply([ sort { $a <=> $b } keys %$res ], [ sort { $a <=> $b } @kids[0, 1] ], 'alternatives');
+is(getpriority(0, $kids[0]), 5, 'niced');
+is(getpriority(0, $kids[2]), getpriority(0, $$), 'others left alone');
+
+SKIP: {
+  skip 'Linux only', 3 unless $^O eq 'linux';
+  $res = $t->apply( where => { pid => $kids[0] }, ioprio => 'idle', affinity => [0] );
+  is($res->{ $kids[0] }, 0, 'ioprio and affinity');
+  $res = $t->apply( where => { pid => $kids[0] }, affinity => [100000] );
+  is($res->{ $kids[0] }, POSIX::EINVAL(), 'bad CPU');
+  $res = $t->apply( where => { pid => $kids[0] }, nice => -20 );
+  ok($> == 0 ? $res->{ $kids[0] } == 0 : $res->{ $kids[0] } != 0, 'errno per pid');
+}
+
+is_deeply($t->apply( where => { pid => $$ }, signal => 0 ), {}, 'never the caller');
+
+$res = $t->apply( where => { cmndline => qr/^$marker/, fname => 'no_such_fname' }, signal => 'KILL' );
+is_deeply($res, {}, 'all fields must match');
+
+$res = $t->apply( where => { cmndline => qr/^$marker/ }, signal => 'KILL' );
+is(scalar(grep { $_ == 0 } values %$res), 3, 'killed');
+waitpid($_, 0) for @kids;
+
+eval { $t->apply( where => { no_such_field => 1 } ) };
+like($@, qr/unknown field `no_such_field'/, 'unknown field');
+eval { $t->apply( where => {}, ioprio => 'fast' ) };
+like($@, qr/ioprio must be/, 'bad ioprio');
+for my $io (qw(be/8 be/9 rt/10 none/5 idle/3)) {
+  eval { $t->apply( where => { pid => -42 }, ioprio => $io ) };
+  like($@, qr/ioprio must be/, "bad ioprio $io");
+}
+ok(eval { $t->apply( where => { pid => -42 }, ioprio => $_ ); 1 }, "ioprio $_")
+  for qw(none idle be be/0 rt/7);
+eval { $t->apply( signal => 0 ) };
+like($@, qr/where must be/, 'where is required');
+
+done_testing;
@@ -0,0 +1,45 @@
+use strict;
+use warnings;
+use Test::More;
+
+use Proc::ProcessTable;
+
+my $t = Proc::ProcessTable->new( enable_ttys => 0 );
+
+my ( $new, $exited, $changed ) = $t->delta;
+ok( scalar @$new, 'every process is new on the first call' );
+is( scalar @$exited,  0, 'none exited' );
+is( scalar @$changed, 0, 'none changed' );
+ok( ( grep { $_->pid == $$ } @$new ), 'this process is among them' );
+
+my $pid = fork;
+die "fork: $!" unless defined $pid;
+if ( $pid == 0 ) {
+  sleep 30;
+  exit 0;
+}
+
+# burn some CPU so this process changes
+my $x = 0;
+$x += $_ for 1 .. 2_000_000;
+
+( $new, $exited, $changed ) = $t->delta( changed => ['time'] );
+ok( ( grep { $_->pid == $pid } @$new ), 'the child is new' );
+ok( !( grep { $_->pid == $$ } @$new ), 'this process is not' );
+ok( ( grep { $_->pid == $$ } @$changed ), 'but its time changed' );
+
+kill 'KILL', $pid;
+waitpid( $pid, 0 );
+
+( $new, $exited, $changed ) = $t->delta( changed => { time => 1e12 } );
+my ($gone) = grep { $_->pid == $pid } @$exited;
+ok( $gone, 'the child exited' );
+is( $gone->ppid, $$, 'and its view shows the old values' ) if $gone;
+ok( !( grep { $_->pid == $$ } @$changed ), 'a high threshold hides small changes' );
+
+eval { $t->delta( changed => { no_such_field => 0 } ) };
+like( $@, qr/unknown field `no_such_field'/, 'unknown fields are an error' );
+eval { $t->delta( changed => { time => -1 } ) };
+like( $@, qr/threshold for time/, 'thresholds are checked' );
+
+done_testing();
@@ -0,0 +1,73 @@
+use strict;
+use warnings;
+use Test::More;
+
+use Proc::ProcessTable;
+
+plan skip_all => 'process events are only available on Linux'
+  unless defined &Proc::ProcessTable::_events_open;
+
+my $t  = Proc::ProcessTable->new( enable_ttys => 0 );
+my $ev = eval { $t->events( live => 1 ) };
+plan skip_all => "can't subscribe to process events: $@" unless $ev;
+
+# Wait for events until $done says so
+sub wait_for {
+  my ($done) = @_;
+  my @seen;
+  my $rin = '';
+  vec( $rin, $ev->fd, 1 ) = 1;
+  for ( 1 .. 50 ) {
+    push @seen, $ev->read;
+    return @seen if $done->(@seen);
+    select( my $rout = $rin, undef, undef, 0.1 );
+  }
+  return @seen;
+}
+
+ok( $ev->fd > 2, 'a descriptor to wait on' );
+ok( $ev->by_pid($$), 'the live table has this process' );
+
+my $pid = fork;
+die "fork: $!" unless defined $pid;
+if ( $pid == 0 ) {
+  exec $^X, '-e', 'sleep 30';
+  exit 1;
+}
+
+my @seen = wait_for( sub { grep { $_->{what} eq 'exec' && $_->{pid} == $pid } @_ } );
+my ($fork) = grep { $_->{what} eq 'fork' && $_->{pid} == $pid } @seen;
+ok( $fork, 'the fork is seen' );
+is( $fork->{ppid}, $$, 'with its parent' ) if $fork;
+ok( ( grep { $_->{what} eq 'exec' && $_->{pid} == $pid } @seen ), 'and the exec' );
+
+my $child = $ev->by_pid($pid);
+ok( $child, 'the child is in the live table' );
+like( $child->cmndline, qr/sleep 30/, 'as it is after the exec' ) if $child;
+
+kill 'TERM', $pid;
+waitpid( $pid, 0 );
+@seen = wait_for( sub { grep { $_->{what} eq 'exit' && $_->{pid} == $pid } @_ } );
+my ($exit) = grep { $_->{what} eq 'exit' && $_->{pid} == $pid } @seen;
+ok( $exit, 'the exit is seen' );
+is( $exit->{exit_code} & 127, 15, 'with the signal' ) if $exit;
+ok( !$ev->by_pid($pid), 'and the child left the live table' );
+ok( ( grep { $_->pid == $$ } @{ $ev->table } ), 'which still has this process' );
+
+# a child that exits through perl's destructors mustn't unsubscribe us
+my $quiet = fork;
+die "fork: $!" unless defined $quiet;
+exit 0 unless $quiet;
+waitpid( $quiet, 0 );
+my $next = fork;
+die "fork: $!" unless defined $next;
+exec $^X, '-e', '0' unless $next;
+waitpid( $next, 0 );
+@seen = wait_for( sub { grep { $_->{what} eq 'exit' && $_->{pid} == $next } @_ } );
+ok( ( grep { $_->{what} eq 'exit' && $_->{pid} == $next } @seen ), 'events keep coming after a fork' );
+
+my $plain = $t->events;
+eval { $plain->table };
+like( $@, qr/live => 1/, 'only live objects have a table' );
+
+done_testing();
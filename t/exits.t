@@ -0,0 +1,62 @@
+use strict;
+use warnings;
+use Test::More;
+
+use Proc::ProcessTable;
+
+plan skip_all => 'exit accounting is only available on Linux'
+  unless defined &Proc::ProcessTable::_exits_open;
+
+my $t     = Proc::ProcessTable->new( enable_ttys => 0 );
+my $exits = eval { $t->exits };
+plan skip_all => "can't register for exit accounting: $@" unless $exits;
+my $by_uid = $t->exits( by => 'uid' );
+
+# Read until $done says so
+sub wait_for {
+  my ( $ex, $done ) = @_;
+  my @seen;
+  my $rin = '';
+  vec( $rin, $ex->fd, 1 ) = 1;
+  for ( 1 .. 50 ) {
+    push @seen, $ex->read;
+    return @seen if $done->(@seen);
+    select( my $rout = $rin, undef, undef, 0.1 );
+  }
+  return @seen;
+}
+
+# a short lived child that uses some CPU
+my $pid = fork;
+die "fork: $!" unless defined $pid;
+if ( $pid == 0 ) {
+  my $x = 0;
+  $x += $_ for 1 .. 1_000_000;
+  exit 3;
+}
+waitpid( $pid, 0 );
+
+my ($rec) = grep { $_->{pid} == $pid } wait_for( $exits, sub { grep { $_->{pid} == $pid } @_ } );
+ok( $rec, 'the exit of the child is seen' );
+SKIP: {
+  skip 'no record', 6 unless $rec;
+  is( $rec->{ppid}, $$, 'with its parent' );
+  is( $rec->{uid}, $<, 'its uid' );
+  is( $rec->{exit_code} >> 8, 3, 'and its exit status' );
+  ok( $rec->{time} > 0, 'it used CPU' );
+  is( $rec->{time}, $rec->{utime} + $rec->{stime}, 'user and system add up' );
+  ok( $rec->{maxrss} > 0, 'and memory' );
+}
+
+is_deeply( [ $by_uid->read ], [], 'read returns nothing for totals' );
+my $totals = $by_uid->totals( reset => 1 );
+ok( $totals->{$<}, 'the exit is in the totals of our uid' );
+ok( $totals->{$<}{count} >= 1, 'counted' ) if $totals->{$<};
+is_deeply( $by_uid->totals, {}, 'reset starts over' );
+
+eval { $exits->totals };
+like( $@, qr/by => 'uid' or 'fname'/, 'records have no totals' );
+eval { $t->exits( by => 'gid' ) };
+like( $@, qr/by must be uid or fname/, 'by is checked' );
+
+done_testing();
@@ -0,0 +1,61 @@
+use strict;
+use warnings;
+use Test::More;
+use Proc::ProcessTable;
+use Storable qw(dclone);
+
+my $t = Proc::ProcessTable->new;
+plan skip_all => 'pidfds are not supported here'
+  unless Proc::ProcessTable::Process->can('handle');
+
+sub child {
+  my $pid = fork;
+  die "fork: $!" unless defined $pid;
+  unless ($pid) {
+    sleep 30;
+    exit 0;
+  }
+  return $pid;
+}
+
+my $pid = child();
+my ($p) = grep { $_->pid == $pid } @{ $t->table( pidfds => 1 ) };
+my $h = $p && $p->{Handle};
+unless ($h) {
+  kill 'KILL', $pid;
+  waitpid($pid, 0);
+  plan skip_all => 'no pidfds from this kernel';
+}
+isa_ok($h, 'Proc::ProcessTable::Handle');
+is($h->pid, $pid, 'handle pid');
+ok($h->fd >= 0, 'handle fd');
+ok($h->alive, 'alive');
+is($p->handle, $h, 'handle is kept on the object');
+
+ok($p->kill(0), 'signal 0 through the pidfd');
+ok($p->kill('TERM'), 'TERM through the pidfd');
+waitpid($pid, 0);
+ok(!$h->alive, 'not alive after exit');
+ok(!$p->kill('TERM'), 'no signal to a reaped process');
+my $prio = $p->{priority};
+$p->priority($prio + 1);
+is($p->{priority}, $prio, 'priority not set once gone');
+
+# a process object with the wrong start time gets no handle
+my $me = $t->by_pid($$);
+delete $me->{Handle};
+$me->{start} += 1000;
+ok(!defined $me->handle, 'start time is checked');
+
+my $copy = dclone($me);
+ok(!exists $copy->{Handle}, 'Storable drops the handle');
+
+$t->table;
+my $self = $t->by_pid($$);
+ok(!exists $self->{Handle}, 'no handles without pidfds');
+ok($self->handle, 'handle on demand');
+
+eval { $t->table( packed => 1, pidfds => 1 ) };
+like($@, qr/packed/, 'no pidfds for packed tables');
+
+done_testing;
@@ -0,0 +1,41 @@
+use strict;
+use warnings;
+use Test::More;
+use Proc::Killall;
+
+my $marker = "ppt_killall_$$";
+
+sub child {
+  my $pid = fork;
+  die "fork: $!" unless defined $pid;
+  unless ($pid) {
+    exec $^X, '-e', 'sleep 30', $marker;
+    exit 1;
+  }
+  return $pid;
+}
+
+my @kids = (child(), child());
+# wait for both to exec
+for (1 .. 50) {
+  last if Proc::Killall::killall(0, $marker) == 2;
+  select(undef, undef, undef, 0.1);
+}
+
+is(killall('ZERO', "^nothing_$marker\$"), 0, 'no match');
+is(killall(0, $marker), 2, 'signal 0 to both');
+is(killall('TERM', "-e sleep 30 $marker"), 2, 'TERM to both');
+for my $kid (@kids) {
+  is(waitpid($kid, 0), $kid, 'child exited');
+  is($? & 127, 15, 'by TERM');
+}
+is(killall('TERM', $marker), 0, 'nothing left');
+
+# never the caller itself
+$0 = "ppt_killall_self_$$";
+is(killall(0, "ppt_killall_self_$$"), 0, 'not ourselves');
+
+eval { killall('NOSUCHSIG', $marker) };
+like($@, qr/Unsupported signal/, 'bad signal');
+
+done_testing;
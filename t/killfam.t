@@ -0,0 +1,85 @@
+use strict;
+use warnings;
+use Test::More;
+use POSIX ();
+use Proc::ProcessTable;
+use Proc::Killfam;
+
+my $marker = "ppt_killfam_$$";
+my $t = Proc::ProcessTable->new( enable_ttys => 0 );
+
+# the live processes of the trees, wherever they were reparented to
+sub members {
+  return grep { ($_->cmndline || '') =~ /^$marker/ && $_->state ne 'defunct' }
+    @{ $t->table };
+}
+
+sub settle {
+  my $want = shift;
+  for (1 .. 100) {
+    return scalar members() if members() == $want;
+    select(undef, undef, undef, 0.05);
+  }
+  return scalar members();
+}
+
+# a tree of processes, every one with two children down to depth; with
+# $every, each keeps forking a child every $every seconds
+sub tree {
+  my ($depth, $every) = @_;
+  my $pid = fork;
+  die "fork: $!" unless defined $pid;
+  return $pid if $pid;
+
+  $0 = "$marker $depth";
+  tree($depth - 1, $every) for $depth > 0 ? (1, 2) : ();
+  if ($every) {
+    for (1 .. 200) {
+      select(undef, undef, undef, $every);
+      tree(0, 0) if $depth > 0;
+    }
+  }
+  sleep 30;
+  POSIX::_exit(0);
+}
+
+my $root = tree(2);
+is(settle(7), 7, 'tree is up');
+is(killfam('TERM', $root), 7, 'whole tree signalled');
+waitpid($root, 0);
+is(settle(0), 0, 'no stragglers');
+
+is(killfam(0, 999999999), 0, 'nothing to signal');
+ok($!, '$! set');
+
+eval { killfam('NOSUCHSIG', $$) };
+like($@, qr/Unrecognized signal/, 'bad signal');
+
+# a tree that keeps forking while it is killed
+$root = tree(2, 0.005);
+select(undef, undef, undef, 0.3);
+ok(killfam({ freeze => 1 }, 'TERM', $root) >= 7, 'frozen tree signalled');
+waitpid($root, 0);
+is(settle(0), 0, 'no stragglers after freeze');
+
+# a process forking as fast as it can while it is frozen
+$root = fork;
+die "fork: $!" unless defined $root;
+unless ($root) {
+  $0 = "$marker forker";
+  for (1 .. 500) {
+    my $pid = fork;
+    next if !defined $pid || $pid;
+    $0 = "$marker kid";
+    sleep 30;
+    POSIX::_exit(0);
+  }
+  sleep 30;
+  POSIX::_exit(0);
+}
+select(undef, undef, undef, 0.05);
+ok(killfam({ freeze => 1 }, 'KILL', $root) >= 1, 'forking process signalled');
+waitpid($root, 0);
+is(settle(0), 0, 'no stragglers of a fork loop');
+
+done_testing;
@@ -0,0 +1,74 @@
+use strict;
+use warnings;
+use Test::More;
+use Time::HiRes qw(time sleep);
+use POSIX ':sys_wait_h';
+
+use Proc::ProcessTable;
+
+plan skip_all => 'profiling is only available on Linux'
+  unless defined &Proc::ProcessTable::_profile_start;
+
+my $t = Proc::ProcessTable->new( enable_ttys => 0 );
+
+eval { $t->profile( pid => $$, hz => 0 ) };
+like( $@, qr/hz must be/, 'hz is checked' );
+eval { $t->profile };
+like( $@, qr/pid must be/, 'pid is required' );
+
+# a child with a busy grandchild
+pipe( my $r, my $w ) or die "pipe: $!";
+my $child = fork;
+die "fork: $!" unless defined $child;
+if ( $child == 0 ) {
+  close $r;
+  my $grandchild = fork;
+  if ( defined $grandchild && $grandchild == 0 ) {
+    my $until = time + 2;
+    my $x     = 0;
+    $x++ while time < $until;
+    exit 0;
+  }
+  print $w "$grandchild\n";
+  close $w;
+  waitpid( $grandchild, 0 );
+  exit 0;
+}
+close $w;
+chomp( my $grandchild = <$r> );
+
+my $prof = $t->profile( pid => $child, hz => 50 );
+isa_ok( $prof, 'Proc::ProcessTable::Profile' );
+ok( $prof->running, 'it runs' );
+
+# a zombie is still there, so reap the child while draining
+my $tsv = '';
+my $reaped;
+for ( 1 .. 1000 ) {
+  $tsv .= $prof->drain;
+  $reaped ||= waitpid( $child, WNOHANG ) == $child;
+  last if $reaped && !$prof->running;
+  sleep 0.01;
+}
+ok( !$prof->running, 'it stops when the process exits' );
+$tsv .= $prof->drain;
+
+my ( $header, @lines ) = split /\n/, $tsv;
+is( $header, "tp\ttime\tpids\trss\tvsz\tpcpu", 'the header of contrib/ppt_profile.pl' );
+ok( @lines > 20, 'many samples (' . scalar(@lines) . ')' );
+is( scalar( grep { split( /\t/, $_ ) != 6 } @lines ), 0, 'all with six columns' );
+ok( ( grep { ( split /\t/ )[2] =~ /\b$grandchild\b/ } @lines ), 'the grandchild is sampled' );
+my ($busy) = sort { $b <=> $a } map { ( split /\t/ )[5] } @lines;
+ok( $busy > 0.1, "and busy ($busy)" );
+is( $prof->drain, '', 'nothing is left' );
+
+# a buffer that is too small loses the oldest samples
+$prof = $t->profile( pid => $$, hz => 200, size => 5 );
+sleep 0.2;
+$prof->stop;
+ok( !$prof->running, 'stop stops it' );
+my @kept = split /\n/, $prof->drain;
+ok( $prof->dropped > 0, 'samples were dropped' );
+ok( @kept <= 6, 'the rest is drained' );
+
+done_testing();
@@ -0,0 +1,33 @@
+use strict;
+use warnings;
+use Test::More;
+use Time::HiRes qw(time);
+
+use Proc::ProcessTable;
+
+my $t = Proc::ProcessTable->new( enable_ttys => 0 );
+
+is_deeply( $t->rates, {}, 'the first call has nothing to compare with' );
+
+# keep this process busy for a while
+my $until = time + 0.5;
+my $x     = 0;
+$x++ while time < $until;
+
+my $rates = $t->rates;
+my $me    = $rates->{$$};
+ok( $me, 'this process has rates' );
+
+SKIP: {
+  skip 'no rates for this process', 5 unless $me;
+  ok( $me->{pctcpu} > 10, "it was busy ($me->{pctcpu}%)" );
+  ok( $me->{pctcpu} < 150, 'but only on one CPU' );
+  SKIP: {
+    skip 'no user and system times', 1 unless exists $me->{pctuser};
+    ok( abs( $me->{pctuser} + $me->{pctsys} - $me->{pctcpu} ) < 1, 'user and system add up' );
+  }
+  ok( $me->{minflt_rate} >= 0, 'minor faults per second' ) if exists $me->{minflt_rate};
+  ok( !grep( { !/^(pctcpu|pctuser|pctsys|minflt_rate|majflt_rate)$/ } keys %$me ), 'and nothing else' );
+}
+
+done_testing();
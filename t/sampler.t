@@ -0,0 +1,75 @@
+use strict;
+use warnings;
+use Test::More;
+use Time::HiRes qw(sleep);
+
+use Proc::ProcessTable;
+
+plan skip_all => 'background sampling is only available on Linux'
+  unless defined &Proc::ProcessTable::_sampler_start;
+
+my $t = Proc::ProcessTable->new( enable_ttys => 0 );
+
+eval { $t->latest };
+like( $@, qr/no sampler running/, 'latest needs a sampler' );
+eval { $t->start_sampler( interval => 0 ) };
+like( $@, qr/interval must be a positive number/, 'interval is checked' );
+
+$t->start_sampler( interval => 20 );
+my $snap;
+for ( 1 .. 500 ) {
+  last if $snap = $t->latest;
+  sleep 0.01;
+}
+isa_ok( $snap, 'Proc::ProcessTable::Snapshot', 'latest' );
+ok( $snap->count > 0, 'with some processes' );
+my $me = $snap->by_pid($$);
+ok( $me, 'including this one' );
+is( $me->pid, $$, 'with the right pid' ) if $me;
+is( $t->by_pid($$)->pid, $$, 'by_pid uses the latest snapshot' );
+
+# the thread moves on while we hold on to the old snapshot
+my $first = $snap;
+my $next;
+for ( 1 .. 500 ) {
+  $next = $t->latest;
+  last if $$next != $$first;
+  sleep 0.01;
+}
+isnt( $$next, $$first, 'a newer snapshot is published' );
+is( $first->by_pid($$)->pid, $$, 'the old one is still readable' );
+undef $first;
+undef $snap;
+
+my $pid = fork;
+die "fork: $!" unless defined $pid;
+if ( $pid == 0 ) {
+  my $ok = $t->latest && $t->latest->by_pid(getppid) ? 0 : 1;
+  undef $t;
+  exit $ok;
+}
+waitpid( $pid, 0 );
+is( $?, 0, 'the child of a fork gets the last snapshot and exits' );
+
+$t->stop_sampler;
+ok( !$t->{Sampler}, 'stop_sampler stops it' );
+eval { $t->latest };
+like( $@, qr/no sampler running/, 'and latest complains again' );
+
+# start_async: wait for the fd instead of polling
+my $fd = $t->start_async( interval => 20 );
+ok( $fd > 2, 'start_async returns a descriptor' );
+my $rin = '';
+vec( $rin, $fd, 1 ) = 1;
+my $rout;
+ok( select( $rout = $rin, undef, undef, 10 ), 'which becomes readable' );
+my $got = $t->harvest;
+isa_ok( $got, 'Proc::ProcessTable::Snapshot', 'harvest' );
+ok( $got->by_pid($$), 'with this process' );
+my $again = $t->harvest;
+ok( !$again || $$again != $$got, 'a snapshot is harvested only once' );
+$t->stop_sampler;
+eval { $t->harvest };
+like( $@, qr/no sampler running/, 'harvest needs a sampler' );
+
+done_testing();
@@ -0,0 +1,27 @@
+use strict;
+use warnings;
+use Test::More;
+
+use Proc::ProcessTable;
+
+my $t = Proc::ProcessTable->new( enable_ttys => 0 );
+
+my @schema = $t->schema;
+ok( @schema > 0, 'schema describes some fields' );
+is_deeply( [ map { $_->{name} } @schema ], [ $t->fields ], 'the same fields as fields()' );
+is( scalar( grep { $_->{type} !~ /^(int|long|string|array|scalar)$/ } @schema ), 0, 'with known types' );
+
+my ($pid) = grep { $_->{name} eq 'pid' } @schema;
+is( $pid->{type}, 'int', 'pids are ints' );
+
+SKIP: {
+  skip 'units are only known on Linux', 2 unless $^O eq 'linux';
+  my %unit = map { $_->{name} => $_->{unit} } @schema;
+  is( $unit{rss}, 'bytes', 'rss is in bytes' );
+  is( $unit{utime}, 'microseconds', 'utime in microseconds' );
+}
+
+eval { Proc::ProcessTable->schema };
+like( $@, qr/Must call schema from an initalized object/, 'schema needs an object' );
+
+done_testing();
@@ -0,0 +1,158 @@
+use strict;
+use warnings;
+use Config;
+use Test::More;
+
+use Proc::ProcessTable;
+
+my $t = Proc::ProcessTable->new( enable_ttys => 0 );
+
+# by_pid reads a table on first use
+my $me = $t->by_pid($$);
+ok( $me, 'by_pid finds our own process' );
+is( $me->pid, $$, 'with the right pid' );
+
+my $table = $t->table;
+is( $t->by_pid($$), ( grep { $_->pid == $$ } @$table )[0], 'the object comes from the last table' );
+ok( !defined $t->by_pid(-42), 'unknown pids give undef' );
+
+# repeated strings are shared between processes, but still copied on write
+my ( $p1, $p2 ) = grep { defined $_->{state} && $_->{state} eq $me->{state} } @$table;
+SKIP: {
+  skip 'only one process in this state', 1 unless $p2;
+  $p1->{state} .= 'x';
+  is( $p2->{state}, $me->{state}, 'modifying a shared string leaves the others alone' );
+}
+
+# accessors hand out copies, and only set fields the object has
+{
+  my ($obj) = grep { $_->{pid} == $$ } @{ $t->table };
+  my $fname = $obj->{fname};
+  $_ .= 'x' for $obj->fname;
+  is( $obj->{fname}, $fname, 'modifying what an accessor returned leaves the object alone' );
+  is( $obj->fname('other'), 'other', 'setting returns the new value' );
+  is( $obj->{fname}, 'other', 'and stores it' );
+  delete $obj->{fname};
+  ok( !eval { $obj->fname('x'); 1 }, 'setting a field the object lacks croaks' );
+  ok( !exists $obj->{fname}, 'and does not add it' );
+  $obj->{not_a_field} = 1;
+  is( $obj->not_a_field, 1, 'other keys read through AUTOLOAD' );
+  ok( !defined &Proc::ProcessTable::Process::not_a_field, 'without getting an accessor' );
+}
+
+SKIP: {
+  skip 'no cmdline and environ on this system', 4
+    unless grep { $_ eq 'cmdline' } $t->fields and grep { $_ eq 'environ' } $t->fields;
+  is( ref $me->cmdline, 'ARRAY', 'cmdline reads as an array' );
+  is( $me->argv(-1), $me->cmdline->[-1], 'argv picks single arguments' );
+  is( $me->env('PATH'), $ENV{PATH}, 'env looks up variables' );
+  ok( !defined $me->env('NO_SUCH_VARIABLE_HERE'), 'unknown variables are undef' );
+}
+
+# values stored before the arrays were ever read replace them
+SKIP: {
+  skip 'no cmdline and environ on this system', 6
+    unless grep { $_ eq 'cmdline' } $t->fields and grep { $_ eq 'environ' } $t->fields;
+  my ($fresh) = grep { $_->{pid} == $$ } @{ $t->table };
+  my ($other) = grep { $_->{pid} == $$ } @{ $t->table };
+  $fresh->{cmdline} = [qw(a b)];
+  is_deeply( $fresh->{cmdline}, [qw(a b)], 'cmdline set to an array' );
+  is( $fresh->argv(1), 'b', 'argv sees it' );
+  $fresh->{environ} = [ 'X=1' ];
+  is( $fresh->env('X'), 1, 'env sees a stored environ' );
+  is_deeply( $fresh->{environ}, [ 'X=1' ], 'environ set to an array' );
+  $other->{cmdline} = 'x';
+  is( $other->{cmdline}, 'x', 'cmdline set to a string' );
+  $other->{environ} = undef;
+  ok( !defined $other->{environ}, 'environ set to undef' );
+}
+
+# process tree; the child forks a grandchild, both just sleep
+pipe( my $r, my $w ) or die "pipe: $!";
+my $child = fork;
+die "cannot fork" unless defined $child;
+if ( $child == 0 ) {
+  my $grandchild = fork;
+  if ( defined $grandchild && $grandchild == 0 ) {
+    sleep 30;
+    exit 0;
+  }
+  print $w "$grandchild\n";
+  close $w;
+  sleep 30;
+  exit 0;
+}
+close $w;
+chomp( my $grandchild = <$r> );
+
+$t->table;
+is_deeply( [ $t->children($$) ], [$child], 'children' );
+is_deeply( [ $t->descendants($$) ], [ $child, $grandchild ], 'descendants, parents first' );
+is( ( $t->ancestors($grandchild) )[0], $child, 'ancestors start with the parent' );
+ok( ( grep { $_ == $$ } $t->ancestors($grandchild) ), 'and include the grandparent' );
+is_deeply( [ $t->descendants(-42) ], [], 'unknown pids have no relatives' );
+
+my ($root) = $t->rollup($$);
+is( $root->pid, $$, 'rollup returns the root' );
+is( $root->tree_count, 3, 'the subtree has three processes' );
+ok( defined &Proc::ProcessTable::Process::tree_count, 'rollup totals get accessors' );
+my $rss = 0;
+$rss += $t->by_pid($_)->rss for ( $$, $child, $grandchild );
+is( $root->tree_rss, $rss, 'tree_rss sums up the subtree' );
+is( $t->by_pid($grandchild)->tree_count, 1, 'descendants get their totals too' );
+
+# packed tables
+my $snap = $t->table( packed => 1 );
+isa_ok( $snap, 'Proc::ProcessTable::Snapshot' );
+ok( $snap->count > 0, 'the packed table has processes' );
+my $view = $snap->by_pid($$);
+isa_ok( $view, 'Proc::ProcessTable::Process::View' );
+is( $view->pid, $$, 'views read their fields from the snapshot' );
+is( $view->fname, $me->fname, 'same values as the hash objects' );
+is( ref $t->by_pid($$), 'Proc::ProcessTable::Process::View', 'by_pid hands out views of packed tables' );
+is_deeply( [ $t->descendants($$) ], [ $child, $grandchild ], 'tree queries work on packed tables' );
+($root) = $t->rollup($$);
+is( $root->tree_count, 3, 'so does rollup' );
+is( $view->as_hash->{pid}, $$, 'views convert to hash objects' );
+is( $view->kill(0), 1, 'views can be signalled' );
+
+tie my @procs, 'Proc::ProcessTable::Snapshot', $snap;
+is( scalar @procs, $snap->count, 'tied snapshots have the right size' );
+isa_ok( $procs[0], 'Proc::ProcessTable::Process' );
+
+$t->table;
+is( $view->pid, $$, 'later tables leave packed snapshots alone' );
+
+# refreshing keeps the objects of running processes
+$t->table;
+$me = $t->by_pid($$);
+$me->{mine} = 1;
+kill 9, $child;
+waitpid $child, 0;
+$t->table( refresh => 1 );
+is( $t->by_pid($$), $me, 'refresh keeps the objects of running processes' );
+ok( $me->{mine}, 'with the keys the caller added' );
+is( $me->pid, $$, 'and their values' );
+ok( !defined $t->by_pid($child), 'and drops the processes that exited' );
+
+# single processes
+$me->{rss} = -1;
+$me->{cwd} = 'nowhere';
+ok( $me->refresh( fields => ['rss'] ), 'refresh reads running processes' );
+ok( $me->rss >= 0, 'and updates their values' );
+is( $me->cwd, 'nowhere', 'only the fields asked for' );
+my $gone = bless { %$me }, ref $me;
+$gone->{pid} = $child;
+ok( !$gone->refresh, 'refresh is false for processes that exited' );
+
+kill 9, $grandchild;
+
+# new threads must not get a copy of the snapshot, or both free it
+SKIP: {
+  skip 'this perl has no ithreads', 1 unless $Config{useithreads};
+  my $rc = system $^X, ( map { "-I$_" } @INC ), '-Mthreads', '-MProc::ProcessTable', '-e',
+    '$t = Proc::ProcessTable->new( enable_ttys => 0 ); $t->table; threads->create( sub { 1 } )->join';
+  is( $rc, 0, 'a thread started after table() exits cleanly' );
+}
+
+done_testing();
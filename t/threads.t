@@ -0,0 +1,35 @@
+use strict;
+use warnings;
+use Config;
+use Test::More;
+
+BEGIN {
+  plan skip_all => 'this perl has no ithreads' unless $Config{useithreads};
+}
+use threads;
+
+use Proc::ProcessTable;
+
+my $t = Proc::ProcessTable->new( enable_ttys => 0 );
+my $snap = $t->table( packed => 1 );
+
+# every thread scans with its own objects, at the same time
+my @threads = map {
+  threads->create( sub {
+    my $t = Proc::ProcessTable->new( enable_ttys => 0 );
+    my $ok = 1;
+    for ( 1 .. 10 ) {
+      $t->table( refresh => 1 );
+      my $me = $t->by_pid($$);
+      $ok &&= $me && $me->pid == $$ && defined $me->fname;
+    }
+    return $ok;
+  } );
+} 1 .. 4;
+ok( $_->join, 'threads read their own tables' ) for @threads;
+
+ok( $snap->count > 0, 'the snapshot of the main thread is still there' );
+my $table = $t->table;
+is( $table->[0]->pid, $table->[0]{pid}, 'and its objects work' );
+
+done_testing();
@@ -0,0 +1,40 @@
+use strict;
+use warnings;
+use Test::More;
+
+use Proc::ProcessTable;
+
+my $t = Proc::ProcessTable->new( enable_ttys => 0 );
+
+my $top = $t->top( n => 5, by => [ '-rss', 'pid' ] );
+is( ref $top, 'ARRAY', 'top returns an array ref' );
+ok( @$top <= 5, 'top returns at most n processes' );
+isa_ok( $top->[0], 'Proc::ProcessTable::Process' ) if @$top;
+
+my @rss = map { $_->rss } @$top;
+is_deeply( \@rss, [ sort { $b <=> $a } @rss ], 'sorted by descending rss' );
+
+# the same processes as sorting a full table; processes come and go,
+# and their rss changes, between the two scans, so try a few times
+my ( @got, @want );
+for ( 1 .. 10 ) {
+  @got = map { $_->pid } @{ $t->top( n => 5, by => [ '-rss', 'pid' ] ) };
+  my @all = sort { $b->rss <=> $a->rss || $a->pid <=> $b->pid }
+    grep { defined $_->rss } @{ $t->table };
+  @want = map { $_->pid } @all[ 0 .. ( @all < 5 ? $#all : 4 ) ];
+  last if "@got" eq "@want";
+}
+is_deeply( \@got, \@want, 'the top processes of the full table' );
+
+my $by_pid = $t->top( n => 1000000, by => 'pid' );
+my @pids   = map { $_->pid } @$by_pid;
+is_deeply( \@pids, [ sort { $a <=> $b } @pids ], 'sorted by ascending pid' );
+ok( ( grep { $_ == $$ } @pids ), 'our own process is in the table' );
+
+eval { $t->top( n => 3, by => 'no_such_field' ) };
+like( $@, qr/unknown field `no_such_field'/, 'unknown sort field' );
+
+eval { $t->top( n => 0 ) };
+like( $@, qr/n must be a positive integer/, 'n is required' );
+
+done_testing();
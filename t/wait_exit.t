@@ -0,0 +1,45 @@
+use strict;
+use warnings;
+use Test::More;
+use Proc::ProcessTable;
+use Time::HiRes qw(time);
+
+$SIG{CHLD} = 'IGNORE';
+
+my $t = Proc::ProcessTable->new;
+
+sub spawn {
+  my $secs = shift;
+  my $pid = fork;
+  die "fork: $!" unless defined $pid;
+  unless ($pid) {
+    select(undef, undef, undef, $secs);
+    exit 0;
+  }
+  return $pid;
+}
+
+# pids that are not there count as gone right away
+my $dead = spawn(0);
+select(undef, undef, undef, 0.2) while kill 0, $dead;
+is_deeply([ $t->wait_exit( pids => [$dead] ) ], [$dead], 'missing pid is gone');
+
+my $fast = spawn(0.2);
+my $slow = spawn(1);
+
+my $t0 = time;
+my @gone = $t->wait_exit( pids => [ $fast, $slow ] );
+is_deeply(\@gone, [$fast], 'first exit returns that pid');
+cmp_ok(time - $t0, '<', 0.9, 'did not wait for the slow one');
+
+@gone = $t->wait_exit( pids => [ $slow, $$ ], timeout => 0.1 );
+is_deeply(\@gone, [], 'timeout returns nothing');
+
+my $also = spawn(0.2);
+@gone = $t->wait_exit( pids => [ $slow, $also ], all => 1, timeout => 10 );
+is_deeply([ sort { $a <=> $b } @gone ], [ sort { $a <=> $b } $slow, $also ], 'all waits for every pid');
+
+eval { $t->wait_exit( pids => 1 ) };
+like($@, qr/pids must be an array reference/, 'pids is checked');
+
+done_testing;